@@ -4,15 +4,34 @@
  *    - https://en.wikipedia.org/wiki/Chinese_remainder_theorem#Existence_(constructive_proof)
  */
 
-#include <string>         // std::string
-#include <cctype>         // isdigit
+#include <atomic>         // std::atomic
+#include <memory>         // std::unique_ptr
+#include <mutex>          // std::mutex, std::lock_guard
+#include <thread>         // std::thread
+#include <limits>         // std::numeric_limits
 #include <vector>         // std::vector
+#include <utility>        // std::move
+#include <string>         // std::string
+#include <cstdio>         // rename
 #include <cstdlib>        // strtoul
 #include <cstdint>        // uint32_t
-#include <iostream>       // std::cout
-#include <exception>      // std::runtime_error
+#include <fstream>        // std::ofstream
+#include <cstring>        // strlen
+#include <iostream>       // std::cin
+#include <algorithm>      // std::min, std::max, std::copy, std::fill
+#include <exception>      // std::runtime_error, std::exception_ptr
 #include <type_traits>    // std::is_unsigned, std::is_integral
 
+#include <fcntl.h>        // open
+#include <unistd.h>       // close, access
+#include <sys/mman.h>     // mmap, munmap
+#include <sys/stat.h>     // fstat
+
+#include "mod_int.hpp"    // Barrett, ModInt, batch
+#include "tokenizer.hpp"  // Tokenizer, skip_integers
+#include "output.hpp"     // OutputSink, OutputBlock
+#include "lookup.hpp"     // GrowableLookup
+
 using value_type = uint32_t;
 static_assert(std::is_unsigned<value_type>(), "Value type is signed!");
 
@@ -100,32 +119,89 @@ constexpr type mod_inv(uint64_t value, type modulo) {
 
 }
 
-/** Simple compile time lookup base template. 
- *  Internal array is zero initialised.
- */ 
-template <typename array_type, value_type n_max>
-class Lookup {
-  protected:
-    array_type lookup[n_max + 1];
+/** Bit packed sieve of Eratosthenes for checking if an integer is prime.
+ *  Stores odd numbers only, one bit each: bit k is set iff 2k + 1 is
+ *  composite, so 10^6 takes ~62 KB. The table grows up to the largest
+ *  value asked for, each new range is sieved segment by segment so
+ *  that each segment fits in cache.
+ */
+class IsPrime {
+
+    /** Generator of the sieve words for GrowableLookup, keeps the odd
+     *  base primes found so far and extends them for each range.
+     */
+    class Segments {
+        static constexpr uint64_t segment_bits = uint64_t(1) << 18;
+
+        std::vector<uint64_t> base;
+        uint64_t candidate;
+      public:
+        Segments() : base(), candidate(3) {}
+
+        void operator()(uint64_t * words, std::size_t first, std::size_t count) {
+          const uint64_t lo = uint64_t(first) * 64;
+          const uint64_t hi = lo + uint64_t(count) * 64;
+
+          // odd base primes up to sqrt(2 hi - 1), by trial division
+          // against the smaller base primes
+          for (; candidate * candidate < 2 * hi; candidate += 2) {
+            bool prime = true;
+            for (auto q : base) {
+              if (q * q > candidate) {
+                break;
+              }
+              if (candidate % q == 0) {
+                prime = false;
+                break;
+              }
+            }
+            if (prime) {
+              base.push_back(candidate);
+            }
+          }
+
+          std::fill(words, words + count, 0);
+
+          // 1 is not prime
+          if (lo == 0) {
+            words[0] |= 1;
+          }
+
+          // strike odd multiples of each base prime in [lo, hi),
+          // one segment at a time
+          for (uint64_t s_lo = lo; s_lo < hi; s_lo += segment_bits) {
+            const uint64_t s_hi = std::min(s_lo + segment_bits, hi);
+            for (auto p : base) {
+              // index of the first odd multiple >= max(p^2, 2 s_lo + 1),
+              // 2k + 1 = 0 (mod p) iff k = (p - 1) / 2 (mod p)
+              uint64_t k = (p * p) / 2;
+              if (k >= s_hi) {
+                break;
+              }
+              if (k < s_lo) {
+                k = s_lo + ((p - 1) / 2 + p - s_lo % p) % p;
+              }
+              for (; k < s_hi; k += p) {
+                words[(k - lo) >> 6] |= uint64_t(1) << (k & 63);
+              }
+            }
+          }
+        }
+    };
+
+    mutable GrowableLookup<uint64_t, Segments> bits;
+
   public:
-    constexpr Lookup() : lookup() {}
-    constexpr array_type operator()(value_type i) const {
-      if (i > n_max) {
-        return 0;
-      }
-      return lookup[i];
+    /** Sieves up to in_max right away, the table grows past it as needed.
+     */
+    explicit IsPrime(value_type in_max = 0) { 
+      bits.reserve(std::size_t(in_max) / 128 + 1); 
     }
-};
 
-/** Lookup for checking if an integer is prime.
- */ 
-template <value_type n_max>
-class IsPrime : public Lookup<bool, n_max> {
-  public:
-    constexpr IsPrime() : Lookup<bool, n_max>() {
-      for (auto i = value_type(1); i <= n_max; i++) {
-        Lookup<bool, n_max>::lookup[i] = IS_PRIME(i);
-      }
+    bool operator()(value_type x) const {
+      const value_type k = x / 2;
+      const bool odd_prime = !((bits[k >> 6] >> (k & 63)) & 1);
+      return (x == 2) | ((x & 1) & odd_prime);
     }
 };
 
@@ -134,171 +210,603 @@ class IsPrime : public Lookup<bool, n_max> {
  *  modulo some integer.
  *
  *  Uses Euler's theorem to get the (n choose k) power of (k + 2).
+ *  The exponent (n choose k) mod t, t = 2 p, is put together via CRT
+ *  from (n choose k) mod 2 (Lucas) and (n choose k) mod p, which is
+ *  carried along each row by the recurrence
+ *    (n choose k) = (n choose k - 1) (n - k + 1) / k.
+ *
+ *  The table grows up to the largest n asked for, the rows of each new
+ *  range are built in parallel. A table can be saved to disk and mapped 
+ *  back in, its rows are then copied instead of being rebuilt.
  */ 
-template <value_type n_max>
-class Product : public Lookup<value_type, n_max> {
+class Product {
     static constexpr value_type modulo = 1000000007;
+    static constexpr value_type t = modulo - 1;
+    static constexpr value_type p = t / 2;
+    static constexpr uint64_t magic = 0x3174636f72502e41;  // "A.Prodt1"
 
     static_assert(IS_PRIME(modulo), "MODULO is not prime!");
+    static_assert(IS_PRIME(p), "(MODULO - 1) / 2 is not prime!");
 
     static_assert((modulo & ~uint32_t(1 << 31)) == modulo, 
                   "MODULO not 31 bit!");
 
-  public:
-    constexpr Product() : Lookup<value_type, n_max>() {
+    /** Layout of the saved table, followed by n_max + 1 values.
+     */
+    struct Header {
+      uint64_t magic;
+      value_type n_max;
+      value_type modulo;
+    };
 
-      value_type t = 1000 * 1000 * 1000 + 6;
-      value_type p = t / 2;
+    using Mod = ModInt<modulo>;
 
-      value_type factorial[n_max + 1] = {1, 1};
-      value_type inv_factorial[n_max + 1] = {1, 1};
+    /** Per thread scratch space, sized for the longest row.
+     */
+    struct Scratch {
+      std::vector<uint64_t> exponent;
+      std::vector<Mod> power;
+    };
 
-      value_type factorial_val = 1;
+    /** Value of row i, inv[j] holds the inverse of j mod p
+     *  and base[j] holds j + 2.
+     */
+    static value_type row(
+      value_type i, 
+      const std::vector<value_type>& inv, 
+      const std::vector<Mod>& base,
+      Scratch& scratch
+    ) {
+      auto bnm_p = value_type(1);
+      for (auto j = value_type(1); j <= i; j++) {
 
-      for (value_type i = 2; i <= n_max; i++) {
-        factorial_val = mod_mul(factorial_val, i, p);
-        factorial[i] = factorial_val;
-        inv_factorial[i] = mod_inv(factorial_val, p);
-      }
+        bnm_p = Barrett<p>::mul(bnm_p, i - j + 1);
+        bnm_p = Barrett<p>::mul(bnm_p, inv[j]);
+
+        auto bnm_2 = binom_mod2(i, j);
+
+        auto offset = t - Barrett<t>::mul(500000002, bnm_p);
 
-      Lookup<value_type, n_max>::lookup[0] = value_type(2);
-      for (auto i = value_type(1); i <= n_max; i++) {
-        auto value = value_type(2);
-        for (auto j = value_type(1); j <= i; j++) {
+        scratch.exponent[j] = Barrett<t>::reduce(offset + bnm_2 * 500000003);
 
-          auto bnm_p = mod_mul(factorial[i], inv_factorial[j], p);
-          bnm_p = mod_mul(bnm_p, inv_factorial[i - j], p);
+      }
 
-          auto bnm_2 = binom_mod2(i, j);
+      // all (j + 2) ^ bnm of the row at once
+      batch::pow(&base[1], &scratch.exponent[1], &scratch.power[1], i);
+      return (Mod(2) * batch::product(&scratch.power[1], i)).value();
+    }
 
-          auto offset = t - mod_mul(500000002, bnm_p, t);
+    /** Generator of the rows for GrowableLookup. Keeps the inverses mod p
+     *  and the bases of the rows so far, rows of a mapped table are copied.
+     */
+    class Rows {
+        const unsigned num_threads;
+        const value_type * mapped;
+        const std::size_t num_mapped;
+        value_type factorial;
+        std::vector<value_type> inv;
+        std::vector<Mod> base;
+
+        /** Extends inv and base to n entries. Continues from the last
+         *  factorial and takes a single mod_inv, 1 / j = (j - 1)! / j!.
+         */
+        void extend(std::size_t n) {
+          const auto old = inv.size();
+          if (n <= old) {
+            return;
+          }
+          std::vector<value_type> prefix(n - old);
+          auto value = factorial;
+          for (auto j = old; j < n; j++) {
+            value = mod_mul(value, j, p);
+            prefix[j - old] = value;
+          }
 
-          auto bnm = (offset + bnm_2 * 500000003) % t;
+          inv.resize(n);
+          base.resize(n);
+          auto inv_factorial = mod_inv(value, p);
+          for (auto j = n - 1; j >= old; j--) {
+            const auto previous = j > old ? prefix[j - old - 1] : factorial;
+            inv[j] = mod_mul(inv_factorial, previous, p);
+            inv_factorial = mod_mul(inv_factorial, j, p);
+            base[j] = Mod(j + 2);
+          }
+          factorial = value;
+        }
 
-          value = mod_mul(value, mod_exp(2 + j, bnm, modulo), modulo);
+      public:
+        Rows(unsigned in_threads, const value_type * in_mapped = nullptr, 
+             std::size_t in_num_mapped = 0)
+          : num_threads(in_threads ? in_threads : 1), mapped(in_mapped), 
+            num_mapped(in_num_mapped), factorial(1), inv(1, 1), 
+            base(1, Mod(2)) {}
+
+        void operator()(value_type * out, std::size_t first, std::size_t count) {
+          if (first < num_mapped) {
+            const auto num_copied = std::min(count, num_mapped - first);
+            std::copy(mapped + first, mapped + first + num_copied, out);
+            out += num_copied;
+            first += num_copied;
+            count -= num_copied;
+          }
+          if (!count) {
+            return;
+          }
+          if (first + count > p) {
+            throw std::runtime_error("Product table size out of range!");
+          }
+          extend(first + count);
+
+          // row i costs O(i), so hand out rows from the top down
+          std::atomic<int64_t> next(first + count - 1);
+          auto worker = [&]() {
+            Scratch scratch = {std::vector<uint64_t>(first + count), 
+                               std::vector<Mod>(first + count)};
+            for (auto i = next--; i >= int64_t(first); i = next--) {
+              out[i - first] = row(value_type(i), inv, base, scratch);
+            }
+          };
 
+          std::vector<std::thread> threads;
+          for (unsigned k = 1; k < num_threads; k++) {
+            threads.emplace_back(worker);
+          }
+          worker();
+          for (auto& thread : threads) {
+            thread.join();
+          }
         }
-        Lookup<value_type, n_max>::lookup[i] = value;
+    };
+
+    /** Maps a table written with save() and checks it.
+     */
+    static const Header * map_table(const char * path, std::size_t& len) {
+      int fd = open(path, O_RDONLY);
+      if (fd < 0) {
+        throw std::runtime_error("Could not open product table!");
+      }
+      struct stat st;
+      if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("Invalid product table!");
+      }
+      len = st.st_size;
+      void * mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map product table!");
+      }
+
+      const auto header = static_cast<const Header *>(mapping);
+      const auto expected = sizeof(Header) 
+                            + (std::size_t(header->n_max) + 1) 
+                              * sizeof(value_type);
+      if (header->magic != magic || header->modulo != modulo 
+          || len != expected) {
+        munmap(mapping, len);
+        throw std::runtime_error("Invalid product table!");
+      }
+      return header;
+    }
+
+    std::size_t mapping_len;
+    const Header * mapping;
+    mutable GrowableLookup<value_type, Rows, 256> table;
+
+  public:
+    /** Empty table, rows are built on num_threads threads.
+     */
+    explicit Product(unsigned num_threads)
+      : mapping_len(0), mapping(nullptr), table(Rows(num_threads)) {}
+
+    /** Table starting from the rows previously written with save().
+     */
+    Product(const char * path, unsigned num_threads)
+      : mapping_len(0), mapping(map_table(path, mapping_len)), 
+        table(Rows(num_threads, 
+                   reinterpret_cast<const value_type *>(mapping + 1),
+                   std::size_t(mapping->n_max) + 1)) {}
+
+    Product(const Product&) = delete;
+    Product& operator=(const Product&) = delete;
+
+    ~Product() {
+      if (mapping) {
+        munmap(const_cast<Header *>(mapping), mapping_len);
       }
     }
+
+    /** Rows in the saved table, 0 if there is none.
+     */
+    std::size_t num_mapped() const {
+      return mapping ? std::size_t(mapping->n_max) + 1 : 0;
+    }
+
+    /** Builds the rows for all n < n_max at once.
+     */
+    void reserve(std::size_t n_max) const { table.reserve(n_max); }
+
+    /** Rows built so far.
+     */
+    std::size_t size() const { return table.size(); }
+
+    /** Writes the rows built so far to path, see Header for the layout.
+     *  Goes through a temporary file, path may be the mapped table.
+     */
+    void save(const char * path) const {
+      std::vector<value_type> values(size());
+      for (std::size_t i = 0; i < values.size(); i++) {
+        values[i] = table[i];
+      }
+      const auto tmp = std::string(path) + ".tmp";
+      std::ofstream os(tmp, std::ios::binary);
+      const Header header = {magic, value_type(values.size() - 1), modulo};
+      os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      os.write(reinterpret_cast<const char *>(values.data()), 
+               values.size() * sizeof(value_type));
+      os.close();
+      if (!os || rename(tmp.c_str(), path) != 0) {
+        throw std::runtime_error("Could not write product table!");
+      }
+    }
+
+    value_type operator()(value_type i) const { return table[i]; }
 };
 
 /** Returns the result for n - number of numbers in input list
  *  m - number of primes among the n input numbers.
+ *
+ *  The result is A_m ^ (2 ^ (n - m)) and since the modulo is prime,
+ *  Euler's theorem reduces the exponent mod (modulo - 1), so a query 
+ *  is a lookup of 2 ^ (n - m) mod (modulo - 1) and a single mod_exp.
+ *  Results are kept in a small direct mapped cache keyed on (n, m),
+ *  owned by the caller, so threads sharing a Formula use one each.
  */
-template <value_type n_max>
+template <value_type modulo>
 class Formula {
-    const value_type modulo;
-    const Product<n_max> product;
+    static constexpr unsigned cache_bits = 12;
+
+    struct Entry {
+      uint64_t key;
+      value_type value;
+    };
+
+  public:
+    class Cache {
+        friend class Formula;
+        std::vector<Entry> entries;
+      public:
+        Cache() 
+          : entries(std::size_t(1) << cache_bits, Entry{~uint64_t(0), 0}) {}
+    };
+
+  private:
+
+    static constexpr value_type totient = modulo - 1;
+
+    /** Largest number of table entries, 2 ^ k for larger k takes a
+     *  mod_exp instead.
+     */
+    static constexpr std::size_t max_table = std::size_t(1) << 20;
+
+    /** Generator of 2 ^ k mod totient for GrowableLookup.
+     */
+    class Powers {
+        value_type value;
+      public:
+        Powers() : value(1) {}
+        void operator()(value_type * out, std::size_t, std::size_t count) {
+          for (std::size_t k = 0; k < count; k++) {
+            out[k] = value;
+            value = mod_mul(value, 2, totient);
+          }
+        }
+    };
+
+    const Product& product;
+    mutable GrowableLookup<value_type, Powers> pow2;
+
+    /** 2 ^ k mod totient.
+     */
+    value_type exponent(value_type k) const {
+      if (k < max_table) {
+        return pow2[k];
+      }
+      return mod_exp(2, k, totient);
+    }
+
   public:
-    /* constexpr */ Formula(value_type imodulo)
-      : modulo(imodulo), product() {}
+    /** Precomputes 2 ^ k mod (modulo - 1) for 0 <= k <= k_max, the
+     *  table grows past it as needed, up to max_table entries.
+     */
+    Formula(const Product& iproduct, value_type k_max)
+      : product(iproduct), pow2() {
+      pow2.reserve(std::min(std::size_t(k_max) + 1, max_table));
+    }
 
-    constexpr value_type operator()(value_type n, value_type m) const {
+    value_type operator()(value_type n, value_type m, Cache& cache) const {
       if (n < 1) {
         return 0;
       }
-      value_type value = product(m);
-      for (auto i = value_type(0); i < n - m; i++) {
-        value = mod_mul(value, value, modulo);
+      const uint64_t key = (uint64_t(n) << 32) | m;
+      auto& entry = cache.entries[(key * 0x9e3779b97f4a7c15) 
+                                  >> (64 - cache_bits)];
+      if (entry.key != key) {
+        entry.key = key;
+        entry.value = ModInt<modulo>(product(m)).pow(exponent(n - m)).value();
       }
-      return value;
+      return entry.value;
     }
 };
 
-template <value_type n_max>
+/** Reads the test cases from stdin and returns numel, number of primes
+ *  for each. With one thread the input is streamed and parsed case by
+ *  case. With more, it is read whole and parsed in two phases: a scan
+ *  for case boundaries that only counts integers, then worker threads
+ *  parsing the cases and counting primes straight into out.
+ */
 class InputParser {
-    const IsPrime<n_max> is_prime;
+    const IsPrime is_prime;
+    const unsigned num_threads;
 
-    value_type parse_int(const char*& ptr) const {
-      char * e_ptr = nullptr;
-      auto value = strtol(ptr, &e_ptr, 10);
-      if (e_ptr == ptr) {
-        throw std::runtime_error("Could not parse integer from input!");
+    /** Cases handed to a worker at a time.
+     */
+    static constexpr std::size_t block = 64;
+
+    struct Case {
+      const char * first;
+      value_type numel;
+    };
+
+    static void check_range(uint64_t value) {
+      if (value > std::numeric_limits<value_type>::max()) {
+        throw std::runtime_error("Input integer out of range!");
       }
-      ptr = e_ptr;
-      return value;
     }
 
-  public:
-    /* constexpr */ InputParser() : is_prime() {}
-    std::vector<value_type> operator()() const {
+    std::vector<value_type> sequential() const {
 
-      // read stdin
-      std::cin.seekg(0, std::ios_base::end);
-      std::size_t len = std::cin.tellg();
-      std::cin.seekg(0, std::ios_base::beg);
-      std::string chars(len, ' ');
-      std::cin.read(static_cast<char *>(&chars[0]), len);
-
-      // get start & end
-      auto ptr = chars.data();
-      const auto end = chars.data() + len;
+      Tokenizer tokens(std::cin);
+      uint64_t value = 0;
 
       // check number of tests
-      while (!isdigit(*ptr) && ptr != end) { ++ptr; }
-      std::vector<value_type> out(2 * parse_int(ptr), 0);
-
-      // stored value counter
-      auto i = value_type(0);
+      if (!tokens.next(value)) {
+        throw std::runtime_error("Could not parse integer from input!");
+      }
+      std::vector<value_type> out(2 * value, 0);
 
       // parse cases
-      while (ptr != end) {
-
-        // skip until next digit
-        while (!isdigit(*ptr)) {
-          if (ptr == end) {
-            goto parse_stdin_end;
-          }
-          ++ptr;
-        }
+      for (std::size_t i = 0; i < out.size() && tokens.next(value); ) {
 
         // get the number of elements & setup count
-        auto numel = parse_int(ptr);
+        const auto numel = value_type(value);
         auto counter = value_type(0);
 
         // count primes
-        for (auto i = value_type(0); i < numel; i++) {
-          while (!isdigit(*ptr)) {
-            if (ptr == end) {
-              throw std::runtime_error("Unexpected end of input!");
-            }
-            ++ptr;
+        for (auto k = value_type(0); k < numel; k++) {
+          if (!tokens.next(value)) {
+            throw std::runtime_error("Unexpected end of input!");
           }
-          counter += is_prime(parse_int(ptr));
+          check_range(value);
+          counter += is_prime(value_type(value));
         }
 
         // push result
         out[i++] = numel;
         out[i++] = counter;
       }
-      parse_stdin_end:
       return out;
     }
+
+    std::vector<value_type> parallel() const {
+      using namespace tokenizer;
+
+      // whole input, followed by zeroed padding
+      std::vector<char> buffer;
+      for (std::size_t len = 0; std::cin; ) {
+        buffer.resize(len + (1 << 20));
+        std::cin.read(buffer.data() + len, 1 << 20);
+        len += std::cin.gcount();
+        buffer.resize(len);
+      }
+      buffer.resize(buffer.size() + padding, 0);
+      const char * p = buffer.data();
+      const char * const end = p + buffer.size() - padding;
+
+      // check number of tests
+      auto next = [&]() {
+        p = skip_to_digit(p, end);
+        const auto run = digit_run_end(p, end);
+        const auto value = parse_digits(p, run - p);
+        p = run;
+        return value;
+      };
+      if (skip_to_digit(p, end) == end) {
+        throw std::runtime_error("Could not parse integer from input!");
+      }
+      std::vector<value_type> out(2 * next(), 0);
+
+      // phase 1: case boundaries, skipping over the integers
+      std::vector<Case> cases;
+      cases.reserve(out.size() / 2);
+      while (cases.size() < out.size() / 2 && skip_to_digit(p, end) != end) {
+        const auto numel = value_type(next());
+        cases.push_back(Case{p, numel});
+        uint64_t n = numel;
+        p = skip_integers(p, end, n);
+        if (n) {
+          throw std::runtime_error("Unexpected end of input!");
+        }
+      }
+
+      // phase 2: blocks of cases handed out to the workers
+      std::atomic<std::size_t> next_block(0);
+      std::exception_ptr error;
+      std::mutex error_mutex;
+      auto worker = [&]() {
+        try {
+          for (auto b = next_block++; b * block < cases.size(); b = next_block++) {
+            const auto last = std::min(cases.size(), (b + 1) * block);
+            for (auto i = b * block; i < last; i++) {
+              const char * q = cases[i].first;
+              auto counter = value_type(0);
+              for (auto k = value_type(0); k < cases[i].numel; k++) {
+                q = skip_to_digit(q, end);
+                const auto run = digit_run_end(q, end);
+                const auto value = parse_digits(q, run - q);
+                q = run;
+                check_range(value);
+                counter += is_prime(value_type(value));
+              }
+              out[2 * i] = cases[i].numel;
+              out[2 * i + 1] = counter;
+            }
+          }
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          error = std::current_exception();
+        }
+      };
+
+      std::vector<std::thread> threads;
+      for (unsigned k = 1; k < num_threads; k++) {
+        threads.emplace_back(worker);
+      }
+      worker();
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      if (error) {
+        std::rethrow_exception(error);
+      }
+      return out;
+    }
+
+  public:
+    InputParser(value_type m_max, unsigned in_threads) 
+      : is_prime(m_max), num_threads(in_threads ? in_threads : 1) {}
+
+    std::vector<value_type> operator()() const {
+      return num_threads > 1 ? parallel() : sequential();
+    }
 };
 
+/** Writes the answer of each (numel, primes) pair of input to out,
+ *  in order. With more than one thread, blocks of cases are handed out
+ *  to workers, which format their answers into an OutputBlock each and
+ *  commit it to out by block index.
+ */
+template <value_type modulo>
+void write_answers(
+  const Formula<modulo>& formula, 
+  const std::vector<value_type>& input, 
+  OutputSink& out,
+  unsigned num_threads
+) {
+  constexpr std::size_t block = 1 << 14;
+  const std::size_t num_cases = input.size() / 2;
+
+  if (num_threads < 2 || num_cases <= block) {
+    typename Formula<modulo>::Cache cache;
+    for (std::size_t i = 0; i < num_cases; i++) {
+      out.put(formula(input[2 * i], input[2 * i + 1], cache));
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next_block(0);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    try {
+      typename Formula<modulo>::Cache cache;
+      for (auto b = next_block++; b * block < num_cases; b = next_block++) {
+        const auto last = std::min(num_cases, (b + 1) * block);
+        OutputBlock answers;
+        for (auto i = b * block; i < last; i++) {
+          answers.put(formula(input[2 * i], input[2 * i + 1], cache));
+        }
+        out.commit(b, std::move(answers));
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      error = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned k = 1; k < num_threads; k++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+/** Parses a non negative integer command line argument.
+ */
+value_type parse_arg(const char * arg) {
+  char * e_ptr = nullptr;
+  auto value = strtoul(arg, &e_ptr, 10);
+  if (e_ptr == arg) {
+    throw std::runtime_error("Could not parse command line argument!");
+  }
+  return value;
+}
+
+/** Usage: a.out [MMAX [NMAX [TABLE]]] < input
+ *  MMAX and NMAX presize the sieve and the tables, which grow past
+ *  them to whatever the input needs. TABLE is a saved Product table, 
+ *  its rows are used if it exists, and it is (re)written whenever the
+ *  input needed more rows than it had.
+ */
 int main(int argc, char** argv) {
 
   /** Constants:
-   *    NMAX - maximum number of input integers
-   *    MMAX - maximum value of an input integer
+   *    NMAX - default presize for the number of input integers
+   *    MMAX - default presize for the value of an input integer
    *    MODULO - 10 ^ 9 + 7
-   *    TOTIENT - is equal n - 1, for any prime n
    */ 
-  constexpr auto NMAX = value_type(1000);
-  constexpr auto MMAX = value_type(1000 * 1000);
+  constexpr auto NMAX = value_type(0);
+  constexpr auto MMAX = value_type(0);
   constexpr auto MODULO = value_type(1000 * 1000 * 1000 + 7);
 
-  /* constexpr */ Formula<NMAX> formula(MODULO);
-  /* constexpr */ InputParser<MMAX> parse_stdin;
-
+  OutputSink out;
   try {
+    const auto m_max = argc > 1 ? parse_arg(argv[1]) : MMAX;
+    const auto n_max = argc > 2 ? parse_arg(argv[2]) : NMAX;
+    const char * table = argc > 3 ? argv[3] : nullptr;
+
+    const auto num_threads = std::thread::hardware_concurrency();
+    std::unique_ptr<Product> product;
+    if (table && access(table, F_OK) == 0) {
+      product.reset(new Product(table, num_threads));
+    } else {
+      product.reset(new Product(num_threads));
+    }
+
+    Formula<MODULO> formula(*product, n_max);
+    InputParser parse_stdin(m_max, num_threads);
     auto input = parse_stdin();
-    for (size_t i = 0; i < input.size(); i += 2) {
-      std::cout << formula(input[i], input[i + 1]) << "\n";
+
+    // rows up to the largest number of primes of the batch, in one go
+    auto m_top = n_max;
+    for (size_t i = 1; i < input.size(); i += 2) {
+      m_top = std::max(m_top, input[i]);
+    }
+    product->reserve(std::size_t(m_top) + 1);
+
+    write_answers(formula, input, out, num_threads);
+    if (table && product->size() > product->num_mapped()) {
+      product->save(table);
     }
   } catch(std::exception& exception) {
-    std::cout << exception.what() << "\n";
+    out.put(exception.what(), strlen(exception.what()));
+    out.put("\n", 1);
   }
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,37 @@
+import sys
+import random
+import argparse
+
+def cases(rng, num_cases, n_max, m_max):
+  '''
+    Yields test cases: the number of integers n in [1, n_max],
+    followed by n integers in [1, m_max].
+  '''
+  for _ in range(num_cases):
+    n = rng.randint(1, n_max)
+    values = [str(rng.randint(1, m_max)) for _ in range(n)]
+    yield '{}\n{}\n'.format(n, ' '.join(values))
+
+def main():
+  parser = argparse.ArgumentParser(description='Writes a seeded query file.')
+  parser.add_argument('--cases', type=int, default=10 ** 6)
+  parser.add_argument('--nmax', type=int, default=8,
+                      help='maximum number of integers per case')
+  parser.add_argument('--mmax', type=int, default=10 ** 6,
+                      help='maximum value of an integer')
+  parser.add_argument('--seed', type=int, default=0)
+  args = parser.parse_args()
+
+  rng = random.Random(args.seed)
+  out = sys.stdout
+  out.write('{}\n'.format(args.cases))
+  batch = []
+  for case in cases(rng, args.cases, args.nmax, args.mmax):
+    batch.append(case)
+    if len(batch) == 1 << 14:
+      out.write(''.join(batch))
+      batch = []
+  out.write(''.join(batch))
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,282 @@
+/** Timing utilities shared by the programs.
+ *
+ *    Timer<Type> - wrapper around std::chrono, toc() returns the time
+ *                  since construction or the last tic() in seconds
+ *    do_not_optimize(value) - keeps a result the compiler could otherwise
+ *                  drop, for benchmarked calls without side effects
+ *    Benchmark   - warmup runs followed by repeated trials, summarised
+ *                  by min, median, p95 and Tukey outliers, with optional
+ *                  hardware counters from perf_event_open
+ *
+ *  Benchmark results print as one JSON object per line, so runs can
+ *  be collected and compared by scripts. Callers can add fields of
+ *  their own to the result through extra.
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <cmath>          // std::sqrt
+#include <chrono>         // std::chrono
+#include <string>         // std::string
+#include <utility>        // std::pair
+#include <vector>         // std::vector
+#include <cstdint>        // uint64_t
+#include <cstring>        // std::memset
+#include <ostream>        // std::ostream
+#include <algorithm>      // std::sort
+
+#ifdef __linux__
+#include <unistd.h>                 // syscall, read, close
+#include <sys/ioctl.h>              // ioctl
+#include <sys/syscall.h>            // __NR_perf_event_open
+#include <linux/perf_event.h>       // perf_event_attr
+#endif
+
+/** Wrapper around std::chrono
+ *
+ */
+template<typename Type>
+class Timer {
+    using Clock = std::chrono::high_resolution_clock;
+    using TimePoint = Clock::time_point;
+    TimePoint tick_point;
+  public:
+    Timer() { tick_point = Clock::now(); }
+    void tic() { tick_point = Clock::now(); }
+    Type toc() {
+      using namespace std::chrono;
+      return duration_cast<duration<Type>>(Clock::now() - tick_point).count();
+    }
+};
+
+/** Forces value to be computed, without generating any code.
+ */
+template<typename Type>
+inline void do_not_optimize(const Type& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/** Cycles, instructions and cache misses of the calling thread, read
+ *  as one perf_event_open group. available() is false when disabled or
+ *  where the syscall is missing or not permitted, reads are then zero.
+ */
+class PerfCounters {
+  public:
+    static constexpr int num_events = 3;
+
+  private:
+    int fds[num_events];
+    bool ok;
+
+#ifdef __linux__
+    static int open_event(uint64_t config, int group_fd) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = config;
+      attr.disabled = group_fd < 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      return int(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+    }
+#endif
+
+  public:
+    explicit PerfCounters(bool enable = true) : fds{-1, -1, -1}, ok(false) {
+#ifdef __linux__
+      if (!enable) {
+        return;
+      }
+      const uint64_t configs[num_events] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES
+      };
+      ok = true;
+      for (int k = 0; k < num_events && ok; k++) {
+        fds[k] = open_event(configs[k], k ? fds[0] : -1);
+        ok = fds[k] >= 0;
+      }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#ifdef __linux__
+      for (auto fd : fds) {
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+#endif
+    }
+
+    bool available() const { return ok; }
+
+    void start() {
+#ifdef __linux__
+      if (ok) {
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+#endif
+    }
+
+    /** Stops counting and stores the counts in values.
+     */
+    void stop(uint64_t (&values)[num_events]) {
+      for (auto& value : values) {
+        value = 0;
+      }
+#ifdef __linux__
+      if (ok) {
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t data[num_events + 1] = {};
+        if (read(fds[0], data, sizeof(data)) == sizeof(data)) {
+          for (int k = 0; k < num_events; k++) {
+            values[k] = data[k + 1];
+          }
+        }
+      }
+#endif
+    }
+};
+
+/** Summary of the trials of one benchmark.
+ */
+struct BenchResult {
+  std::string name;
+  std::size_t trials;
+  double min;
+  double median;
+  double p95;
+  double mean;
+  double stddev;
+  std::size_t outliers;
+  bool has_counters;
+  double counters[PerfCounters::num_events];
+  // values reported by the caller, e.g. the number of rows processed
+  std::vector<std::pair<std::string, uint64_t>> extra;
+
+  /** One line JSON object, counters are null when unavailable.
+   */
+  void print(std::ostream& os) const {
+    static const char * const counter_names[PerfCounters::num_events] = {
+      "cycles", "instructions", "cache_misses"
+    };
+    os << "{\"name\": \"" << name << "\""
+       << ", \"trials\": " << trials
+       << ", \"min\": " << min
+       << ", \"median\": " << median
+       << ", \"p95\": " << p95
+       << ", \"mean\": " << mean
+       << ", \"stddev\": " << stddev
+       << ", \"outliers\": " << outliers;
+    for (int k = 0; k < PerfCounters::num_events; k++) {
+      os << ", \"" << counter_names[k] << "\": ";
+      if (has_counters) {
+        os << counters[k];
+      } else {
+        os << "null";
+      }
+    }
+    for (const auto& field : extra) {
+      os << ", \"" << field.first << "\": " << field.second;
+    }
+    os << "}\n";
+  }
+};
+
+/** Runs a callable warmup times untimed, then trials times timed.
+ *  Times are in seconds, counters are medians over the trials.
+ *  Trials outside the Tukey fences [Q1 - 1.5 IQR, Q3 + 1.5 IQR]
+ *  are counted as outliers, but still part of the statistics.
+ */
+class Benchmark {
+    const std::string name;
+    const std::size_t warmup;
+    const std::size_t trials;
+    PerfCounters perf;
+
+    /** Value at quantile q of sorted values, linearly interpolated.
+     */
+    static double quantile(const std::vector<double>& sorted, double q) {
+      const double pos = q * (sorted.size() - 1);
+      const std::size_t lo = std::size_t(pos);
+      const std::size_t hi = lo + 1 < sorted.size() ? lo + 1 : lo;
+      return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+    }
+
+  public:
+    Benchmark(const std::string& iname,
+              std::size_t iwarmup = 3,
+              std::size_t itrials = 30,
+              bool counters = true)
+      : name(iname), warmup(iwarmup), trials(itrials ? itrials : 1),
+        perf(counters) {}
+
+    template<typename Function>
+    BenchResult run(Function&& function) {
+      for (std::size_t k = 0; k < warmup; k++) {
+        function();
+      }
+
+      std::vector<double> times(trials);
+      std::vector<double> counts[PerfCounters::num_events];
+      uint64_t values[PerfCounters::num_events];
+      Timer<double> timer;
+      for (std::size_t k = 0; k < trials; k++) {
+        perf.start();
+        timer.tic();
+        function();
+        times[k] = timer.toc();
+        perf.stop(values);
+        for (int e = 0; e < PerfCounters::num_events; e++) {
+          counts[e].push_back(double(values[e]));
+        }
+      }
+
+      BenchResult result;
+      result.name = name;
+      result.trials = trials;
+
+      double sum = 0.0;
+      for (auto t : times) {
+        sum += t;
+      }
+      result.mean = sum / trials;
+      double sq = 0.0;
+      for (auto t : times) {
+        sq += (t - result.mean) * (t - result.mean);
+      }
+      result.stddev = trials > 1 ? std::sqrt(sq / (trials - 1)) : 0.0;
+
+      std::sort(times.begin(), times.end());
+      result.min = times.front();
+      result.median = quantile(times, 0.5);
+      result.p95 = quantile(times, 0.95);
+
+      const double q1 = quantile(times, 0.25);
+      const double q3 = quantile(times, 0.75);
+      const double lo = q1 - 1.5 * (q3 - q1);
+      const double hi = q3 + 1.5 * (q3 - q1);
+      result.outliers = 0;
+      for (auto t : times) {
+        result.outliers += t < lo || t > hi;
+      }
+
+      result.has_counters = perf.available();
+      for (int e = 0; e < PerfCounters::num_events; e++) {
+        std::sort(counts[e].begin(), counts[e].end());
+        result.counters[e] = quantile(counts[e], 0.5);
+      }
+      return result;
+    }
+};
+
+#endif  // BENCH_HPP
@@ -0,0 +1,208 @@
+'''
+  Performance regression suite for the programs of this repository.
+
+  Each suite generates a seeded, production sized input with the
+  program's py/generate.py (once, kept in <program>/data/bench/),
+  runs the already built <program>/a.out on it a few times and
+  compares the median wall time with common/baselines.json.
+
+  Usage:
+    python3 common/benchmark.py [PROGRAM ...] [--trials N] [--scale S]
+                                [--tolerance T] [--update]
+
+  --scale multiplies the generated input size, baselines only apply to
+  the scale they were recorded at. --update stores the measured times
+  as the new baselines. The exit status is 1 if any suite is more than
+  the tolerance slower than its baseline.
+
+  Baselines are wall times, so they only apply to the machine they were
+  recorded on: each is stored along with the host name, CPU model and
+  number of cores, and a baseline from another machine is reported as
+  'no baseline'. common/baselines.json is not committed, record it on
+  each machine with --update first.
+'''
+
+import os
+import sys
+import json
+import time
+import argparse
+import platform
+import subprocess
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BASELINES = os.path.join(ROOT, 'common', 'baselines.json')
+
+# size: generator option scaled by --scale, None if the input is fixed
+# stdin: the input is redirected to stdin, otherwise it is an argument
+SUITES = {
+  'str2tuple': {
+    'size': ('--rows', 80 * 10 ** 6),
+    'generate': [],
+    'command': ['./a.out', '{input}', '1'],
+    'stdin': False,
+  },
+  'alice_and_mathematics': {
+    'size': ('--cases', 10 ** 6),
+    'generate': [],
+    'command': ['./a.out'],
+    'stdin': True,
+  },
+  'connected_components': {
+    'size': ('--queries', 10 ** 6),
+    'generate': [],
+    'command': ['./a.out'],
+    'stdin': True,
+  },
+  'stickman_trees': {
+    'size': ('--nodes', 10 ** 6),
+    'generate': [],
+    'command': ['./a.out'],
+    'stdin': True,
+  },
+  'recursive_counter': {
+    'size': None,
+    'generate': ['--length', '9'],
+    'command': ['./a.out', '{args}'],
+    'stdin': False,
+  },
+}
+
+def machine():
+  '''
+    The host name, CPU model and number of cores of this machine.
+  '''
+  cpu = platform.processor() or platform.machine()
+  try:
+    with open('/proc/cpuinfo') as f:
+      for line in f:
+        if line.startswith('model name'):
+          cpu = line.split(':', 1)[1].strip()
+          break
+  except OSError:
+    pass
+  return {'host': platform.node(), 'cpu': cpu, 'cores': os.cpu_count()}
+
+def generate(program, suite, scale, seed):
+  '''
+    Writes the input of a suite unless it exists, returns its path.
+  '''
+  args = list(suite['generate'])
+  tag = 'seed{}'.format(seed)
+  if suite['size']:
+    option, size = suite['size']
+    size = max(1, int(size * scale))
+    args += [option, str(size)]
+    tag += '-{}{}'.format(option.strip('-'), size)
+  directory = os.path.join(ROOT, program, 'data', 'bench')
+  path = os.path.join(directory, tag + '.txt')
+  if not os.path.exists(path):
+    os.makedirs(directory, exist_ok=True)
+    print('generating {}'.format(os.path.relpath(path, ROOT)), file=sys.stderr)
+    script = os.path.join(ROOT, program, 'py', 'generate.py')
+    with open(path + '.tmp', 'w') as out:
+      subprocess.run([sys.executable, script, '--seed', str(seed)] + args,
+                     stdout=out, check=True)
+    os.rename(path + '.tmp', path)
+  return path
+
+def command(suite, path):
+  '''
+    The command line of a suite, with {input} and {args} filled in.
+  '''
+  with open(path) as f:
+    values = f.read().split() if '{args}' in suite['command'] else []
+  cmd = []
+  for arg in suite['command']:
+    if arg == '{args}':
+      cmd += values
+    else:
+      cmd.append(arg.format(input=path))
+  return cmd
+
+def run(program, suite, path, trials):
+  '''
+    Median wall time in seconds of trials runs.
+  '''
+  cwd = os.path.join(ROOT, program)
+  if not os.path.exists(os.path.join(cwd, 'a.out')):
+    raise RuntimeError('{}/a.out not found, run make first'.format(program))
+  cmd = command(suite, path)
+  times = []
+  for _ in range(trials):
+    stdin = open(path, 'rb') if suite['stdin'] else subprocess.DEVNULL
+    start = time.perf_counter()
+    subprocess.run(cmd, cwd=cwd, stdin=stdin,
+                   stdout=subprocess.DEVNULL, check=True)
+    times.append(time.perf_counter() - start)
+    if suite['stdin']:
+      stdin.close()
+  times.sort()
+  return times[len(times) // 2]
+
+def main():
+  parser = argparse.ArgumentParser(description='Runs the benchmark suites.')
+  parser.add_argument('programs', nargs='*', default=sorted(SUITES))
+  parser.add_argument('--trials', type=int, default=3)
+  parser.add_argument('--scale', type=float, default=1.0)
+  parser.add_argument('--seed', type=int, default=0)
+  parser.add_argument('--tolerance', type=float, default=0.1,
+                      help='allowed slowdown relative to the baseline')
+  parser.add_argument('--update', action='store_true',
+                      help='store the measured times as baselines')
+  args = parser.parse_args()
+
+  baselines = {}
+  if os.path.exists(BASELINES):
+    with open(BASELINES) as f:
+      baselines = json.load(f)
+
+  host = machine()
+  regressions = 0
+  for program in args.programs:
+    if program not in SUITES:
+      parser.error('unknown program {}'.format(program))
+    suite = SUITES[program]
+    path = generate(program, suite, args.scale, args.seed)
+    seconds = run(program, suite, path, args.trials)
+    size = os.path.getsize(path)
+
+    result = {
+      'name': program,
+      'scale': args.scale,
+      'seconds': seconds,
+      'mb_per_s': size / seconds / 1e6 if suite['size'] else None,
+      'baseline': None,
+      'ratio': None,
+      'status': 'no baseline',
+    }
+    baseline = baselines.get(program)
+    if baseline and baseline.get('machine') != host:
+      result['status'] = 'no baseline'
+      result['baseline_machine'] = baseline.get('machine')
+    elif baseline and baseline['scale'] == args.scale:
+      result['baseline'] = baseline['seconds']
+      result['ratio'] = seconds / baseline['seconds']
+      if result['ratio'] > 1 + args.tolerance:
+        result['status'] = 'regression'
+        regressions += 1
+      elif result['ratio'] < 1 - args.tolerance:
+        result['status'] = 'faster'
+      else:
+        result['status'] = 'ok'
+    print(json.dumps(result))
+    sys.stdout.flush()
+
+    if args.update:
+      baselines[program] = {'scale': args.scale, 'seconds': seconds,
+                            'machine': host}
+
+  if args.update:
+    with open(BASELINES, 'w') as f:
+      json.dump(baselines, f, indent=2, sort_keys=True)
+      f.write('\n')
+
+  return 1 if regressions else 0
+
+if __name__ == '__main__':
+  sys.exit(main())
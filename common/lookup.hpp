@@ -0,0 +1,127 @@
+/** Lookup table of per index values f(0), f(1), ... grown on demand,
+ *  shared by the programs that precompute tables.
+ *
+ *  Entries are computed in order by a Generator, which keeps whatever
+ *  carries over from one range to the next (the last factorial, the
+ *  base primes of a sieve, ...):
+ *
+ *    struct Generator {
+ *      // writes entries first, ..., first + count - 1 to out, called
+ *      // for consecutive ranges starting at 0, never concurrently
+ *      void operator()(Type * out, std::size_t first, std::size_t count);
+ *    };
+ *
+ *  The table reserves a large range of address space up front and
+ *  commits pages as it grows, so entries never move and a read is a
+ *  single load, as from a plain array. It grows under a mutex in
+ *  multiples of grain entries and publishes its size with release
+ *  semantics, so readers on other threads need no lock below it.
+ */
+
+#ifndef LOOKUP_HPP
+#define LOOKUP_HPP
+
+#include <mutex>          // std::mutex, std::lock_guard
+#include <atomic>         // std::atomic
+#include <cstddef>        // std::size_t
+#include <utility>        // std::move
+#include <new>            // std::bad_alloc
+#include <stdexcept>      // std::length_error
+#include <type_traits>    // std::is_trivial
+
+#include <unistd.h>       // sysconf
+#include <sys/mman.h>     // mmap, mprotect, munmap
+
+template <typename Type, typename Generator, std::size_t grain = 4096>
+class GrowableLookup {
+    static_assert(std::is_trivial<Type>(),
+                  "GrowableLookup stores trivial types only.");
+    static_assert(grain > 0, "GrowableLookup needs a positive grain.");
+
+    /** Address space to reserve, halved until the kernel agrees.
+     */
+    static constexpr std::size_t max_bytes = std::size_t(1) << 40;
+    static constexpr std::size_t min_bytes = std::size_t(1) << 24;
+
+    Generator generator;
+    Type * data;
+    std::size_t capacity;
+    std::size_t committed;
+    std::atomic<std::size_t> count;
+    std::mutex mutex;
+
+    /** Makes the first bytes of the reservation writable.
+     */
+    void commit(std::size_t bytes) {
+      if (bytes <= committed) {
+        return;
+      }
+      const std::size_t page = sysconf(_SC_PAGESIZE);
+      bytes = (bytes + page - 1) / page * page;
+      if (mprotect(data, bytes, PROT_READ | PROT_WRITE) != 0) {
+        throw std::bad_alloc();
+      }
+      committed = bytes;
+    }
+
+  public:
+    explicit GrowableLookup(Generator igenerator = Generator())
+      : generator(std::move(igenerator)), data(nullptr), capacity(0),
+        committed(0), count(0) {
+      for (auto bytes = max_bytes; bytes >= min_bytes; bytes /= 2) {
+        void * ptr = mmap(nullptr, bytes, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr != MAP_FAILED) {
+          data = static_cast<Type *>(ptr);
+          capacity = bytes / sizeof(Type);
+          return;
+        }
+      }
+      throw std::bad_alloc();
+    }
+
+    GrowableLookup(const GrowableLookup&) = delete;
+    GrowableLookup& operator=(const GrowableLookup&) = delete;
+
+    ~GrowableLookup() { munmap(data, capacity * sizeof(Type)); }
+
+    /** Computes the entries below n that are missing.
+     */
+    void reserve(std::size_t n) {
+      if (n <= count.load(std::memory_order_acquire)) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      const auto filled = count.load(std::memory_order_relaxed);
+      if (n <= filled) {
+        return;
+      }
+      if (n > capacity) {
+        throw std::length_error("Lookup table size out of range!");
+      }
+      auto target = (n + grain - 1) / grain * grain;
+      target = target < capacity ? target : capacity;
+      commit(target * sizeof(Type));
+      generator(data + filled, filled, target - filled);
+      count.store(target, std::memory_order_release);
+    }
+
+    /** Number of entries computed so far.
+     */
+    std::size_t size() const { return count.load(std::memory_order_acquire); }
+
+    /** Entry i, which must be below size().
+     */
+    const Type& get(std::size_t i) const { return data[i]; }
+
+    /** Entry i, the table grows first if it does not reach i yet.
+     */
+    const Type& operator[](std::size_t i) {
+      if (i >= count.load(std::memory_order_acquire)) {
+        reserve(i + 1);
+      }
+      return data[i];
+    }
+};
+
+#endif  // LOOKUP_HPP
@@ -0,0 +1,300 @@
+/** Modular arithmetic without hardware division, shared by the
+ *  mod 10^9 + 7 programs.
+ *
+ *    Barrett<P> - exact x % P for any 64 bit x, with a multiply high
+ *                 in place of the division
+ *    DynamicBarrett - the same for a P only known at runtime
+ *    ModInt<P>  - residue mod an odd P < 2^31, kept in Montgomery form
+ *                 with R = 2^32
+ *    batch::    - ModInt kernels over arrays, 4 lanes at a time with AVX2
+ *
+ *  Check out:
+ *    - https://en.wikipedia.org/wiki/Barrett_reduction
+ *    - https://en.wikipedia.org/wiki/Montgomery_modular_multiplication
+ */
+
+#ifndef MOD_INT_HPP
+#define MOD_INT_HPP
+
+#include <cstddef>        // std::size_t
+#include <cstdint>        // uint32_t, uint64_t
+
+#ifdef __AVX2__
+#include <immintrin.h>    // _mm256_*
+#endif
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+/** Barrett reduction by a compile time modulus.
+ *  reduce(x) is equal to x % P for every 64 bit x, so replacing a
+ *  % P by it gives identical results, overflow included.
+ */
+template <uint64_t P>
+class Barrett {
+    static_assert(P > 1 && P < (uint64_t(1) << 32),
+                  "Barrett supports 32 bit moduli only.");
+
+    /** floor((2^64 - 1) / P), the quotient estimate is off by at most one.
+     */
+    static constexpr uint64_t m = ~uint64_t(0) / P;
+
+  public:
+    static constexpr uint64_t reduce(uint64_t x) {
+      const uint64_t q = uint64_t((uint128_t(x) * m) >> 64);
+      const uint64_t r = x - q * P;
+      return r >= P ? r - P : r;
+    }
+
+    /** (left * right) % P, with the product taken mod 2^64.
+     */
+    static constexpr uint64_t mul(uint64_t left, uint64_t right) {
+      return reduce(left * right);
+    }
+};
+
+/** Barrett reduction by a modulus fixed at runtime, 1 < P < 2^32,
+ *  for loops dividing by the same P over and over.
+ */
+class DynamicBarrett {
+    uint64_t p;
+    uint64_t m;
+
+  public:
+    explicit DynamicBarrett(uint64_t modulo)
+      : p(modulo), m(~uint64_t(0) / modulo) {}
+
+    uint64_t modulo() const { return p; }
+
+    /** x / P, stores x % P in rest.
+     */
+    uint64_t divide(uint64_t x, uint64_t& rest) const {
+      uint64_t q = uint64_t((uint128_t(x) * m) >> 64);
+      rest = x - q * p;
+      if (rest >= p) {
+        rest -= p;
+        q++;
+      }
+      return q;
+    }
+
+    uint64_t reduce(uint64_t x) const {
+      const uint64_t q = uint64_t((uint128_t(x) * m) >> 64);
+      const uint64_t r = x - q * p;
+      return r >= p ? r - p : r;
+    }
+
+    uint64_t mul(uint64_t left, uint64_t right) const {
+      return reduce(left * right);
+    }
+};
+
+/** Residue mod P in Montgomery form, i.e. stores x R mod P, R = 2^32.
+ *  Products are reduced with REDC, which needs no division.
+ */
+template <uint32_t P>
+class ModInt {
+    static_assert(P % 2 == 1, "ModInt requires an odd modulus.");
+    static_assert(P < (uint32_t(1) << 31), "ModInt requires a 31 bit modulus.");
+
+    /** -P^{-1} mod 2^32 by Newton's iteration, each step doubles the
+     *  number of correct bits starting from 3.
+     */
+    static constexpr uint32_t neg_inv() {
+      uint32_t x = P;
+      for (int i = 0; i < 4; i++) {
+        x *= 2 - P * x;
+      }
+      return 0 - x;
+    }
+
+    uint32_t v;
+
+  public:
+    static constexpr uint32_t modulo = P;
+    static constexpr uint32_t n_prime = neg_inv();
+    static constexpr uint32_t r2 = uint32_t((0 - uint64_t(P)) % P);
+
+    /** t R^{-1} mod P, for t < P 2^32.
+     */
+    static constexpr uint32_t redc(uint64_t t) {
+      const uint32_t m = uint32_t(t) * n_prime;
+      const uint32_t u = uint32_t((t + uint64_t(m) * P) >> 32);
+      return u >= P ? u - P : u;
+    }
+
+    /** Wraps a value already in Montgomery form.
+     */
+    static constexpr ModInt raw(uint32_t mont) {
+      ModInt x;
+      x.v = mont;
+      return x;
+    }
+
+    constexpr ModInt() : v(0) {}
+    explicit constexpr ModInt(uint64_t x)
+      : v(redc(Barrett<P>::reduce(x) * r2)) {}
+
+    /** The residue, in [0, P).
+     */
+    constexpr uint32_t value() const { return redc(v); }
+
+    /** The Montgomery form, in [0, P).
+     */
+    constexpr uint32_t raw() const { return v; }
+
+    constexpr ModInt& operator+=(ModInt x) {
+      v += x.v;
+      v = v >= P ? v - P : v;
+      return *this;
+    }
+
+    constexpr ModInt& operator-=(ModInt x) {
+      v = v >= x.v ? v - x.v : v + P - x.v;
+      return *this;
+    }
+
+    constexpr ModInt& operator*=(ModInt x) {
+      v = redc(uint64_t(v) * x.v);
+      return *this;
+    }
+
+    friend constexpr ModInt operator+(ModInt x, ModInt y) { return x += y; }
+    friend constexpr ModInt operator-(ModInt x, ModInt y) { return x -= y; }
+    friend constexpr ModInt operator*(ModInt x, ModInt y) { return x *= y; }
+    friend constexpr bool operator==(ModInt x, ModInt y) { return x.v == y.v; }
+    friend constexpr bool operator!=(ModInt x, ModInt y) { return x.v != y.v; }
+
+    /** Exponentiation via squaring.
+     */
+    constexpr ModInt pow(uint64_t exponent) const {
+      ModInt result(1);
+      ModInt value = *this;
+      while (exponent) {
+        if (exponent % 2) {
+          result *= value;
+        }
+        value *= value;
+        exponent /= 2;
+      }
+      return result;
+    }
+
+    /** Inverse via Fermat's little theorem, P must be prime.
+     */
+    constexpr ModInt inv() const { return pow(P - 2); }
+};
+
+namespace batch {
+
+#ifdef __AVX2__
+namespace detail {
+
+/** Montgomery product of 4 residues held in the low halves
+ *  of the 64 bit lanes.
+ */
+template <uint32_t P>
+inline __m256i mul4(__m256i a, __m256i b) {
+  const __m256i p = _mm256_set1_epi64x(P);
+  const __m256i n_prime = _mm256_set1_epi64x(ModInt<P>::n_prime);
+  const __m256i t = _mm256_mul_epu32(a, b);
+  const __m256i m = _mm256_mul_epu32(t, n_prime);
+  const __m256i u = _mm256_srli_epi64(
+                      _mm256_add_epi64(t, _mm256_mul_epu32(m, p)), 32);
+  const __m256i ge = _mm256_cmpgt_epi64(u, _mm256_set1_epi64x(P - 1));
+  return _mm256_sub_epi64(u, _mm256_and_si256(ge, p));
+}
+
+template <uint32_t P>
+inline __m256i load4(const ModInt<P> * ptr) {
+  return _mm256_cvtepu32_epi64(
+           _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr)));
+}
+
+template <uint32_t P>
+inline void store4(ModInt<P> * ptr, __m256i x) {
+  const __m256i low = _mm256_permutevar8x32_epi32(
+                        x, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(ptr),
+                   _mm256_castsi256_si128(low));
+}
+
+}  // namespace detail
+#endif
+
+static_assert(sizeof(ModInt<3>) == sizeof(uint32_t),
+              "ModInt must be layout compatible with uint32_t.");
+
+/** out[k] = left[k] * right[k] for 0 <= k < n.
+ */
+template <uint32_t P>
+void mul(const ModInt<P> * left, const ModInt<P> * right,
+         ModInt<P> * out, std::size_t n) {
+  std::size_t k = 0;
+#ifdef __AVX2__
+  for (; k + 4 <= n; k += 4) {
+    detail::store4(out + k, detail::mul4<P>(detail::load4(left + k),
+                                            detail::load4(right + k)));
+  }
+#endif
+  for (; k < n; k++) {
+    out[k] = left[k] * right[k];
+  }
+}
+
+/** out[k] = base[k] ^ exponent[k] for 0 <= k < n.
+ */
+template <uint32_t P>
+void pow(const ModInt<P> * base, const uint64_t * exponent,
+         ModInt<P> * out, std::size_t n) {
+  std::size_t k = 0;
+#ifdef __AVX2__
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i unit = _mm256_set1_epi64x(ModInt<P>(1).raw());
+  for (; k + 4 <= n; k += 4) {
+    __m256i result = unit;
+    __m256i value = detail::load4(base + k);
+    __m256i e = _mm256_loadu_si256(
+                  reinterpret_cast<const __m256i *>(exponent + k));
+    while (!_mm256_testz_si256(e, e)) {
+      const __m256i odd = _mm256_cmpeq_epi64(_mm256_and_si256(e, one), one);
+      result = _mm256_blendv_epi8(result,
+                                  detail::mul4<P>(result, value), odd);
+      value = detail::mul4<P>(value, value);
+      e = _mm256_srli_epi64(e, 1);
+    }
+    detail::store4(out + k, result);
+  }
+#endif
+  for (; k < n; k++) {
+    out[k] = base[k].pow(exponent[k]);
+  }
+}
+
+/** Product of values[k] for 0 <= k < n.
+ */
+template <uint32_t P>
+ModInt<P> product(const ModInt<P> * values, std::size_t n) {
+  ModInt<P> result(1);
+  std::size_t k = 0;
+#ifdef __AVX2__
+  if (n >= 4) {
+    __m256i acc = _mm256_set1_epi64x(result.raw());
+    for (; k + 4 <= n; k += 4) {
+      acc = detail::mul4<P>(acc, detail::load4(values + k));
+    }
+    ModInt<P> lanes[4];
+    detail::store4(lanes, acc);
+    for (auto lane : lanes) {
+      result *= lane;
+    }
+  }
+#endif
+  for (; k < n; k++) {
+    result *= values[k];
+  }
+  return result;
+}
+
+}  // namespace batch
+
+#endif  // MOD_INT_HPP
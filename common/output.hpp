@@ -0,0 +1,187 @@
+/** Buffered bulk output of unsigned integers, shared by the programs
+ *  writing one answer per line.
+ *
+ *  Integers are formatted two digits per step from a lookup table into
+ *  a reusable buffer, which is handed to write(2) once it passes a size
+ *  threshold, on flush() and on destruction. No iostream, no locale.
+ *
+ *  Results from several threads keep their order by formatting into an
+ *  OutputBlock each and committing the blocks by index: block k is
+ *  written once blocks 0 .. k - 1 have been.
+ */
+
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <map>            // std::map
+#include <mutex>          // std::mutex, std::lock_guard
+#include <cerrno>         // errno, EINTR
+#include <cstddef>        // std::size_t
+#include <cstdint>        // uint64_t
+#include <cstring>        // std::memcpy
+#include <vector>         // std::vector
+#include <utility>        // std::move
+#include <stdexcept>      // std::runtime_error
+
+#include <unistd.h>       // write
+
+namespace output {
+
+/** "00", "01", ..., "99".
+ */
+constexpr char digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536"
+  "37383940414243444546474849505152535455565758596061626364656667686970717273"
+  "7475767778798081828384858687888990919293949596979899";
+
+/** Longest formatted uint64_t.
+ */
+constexpr std::size_t max_digits = 20;
+
+/** Writes the decimal digits of value ending just before end,
+ *  returns the position of the first digit.
+ */
+inline char * format_backwards(uint64_t value, char * end) {
+  while (value >= 100) {
+    const auto pair = (value % 100) * 2;
+    value /= 100;
+    end -= 2;
+    std::memcpy(end, digit_pairs + pair, 2);
+  }
+  if (value >= 10) {
+    end -= 2;
+    std::memcpy(end, digit_pairs + value * 2, 2);
+  } else {
+    *(--end) = char('0' + value);
+  }
+  return end;
+}
+
+/** Writes len bytes to fd, retrying on partial writes.
+ */
+inline void write_all(int fd, const char * ptr, std::size_t len) {
+  while (len) {
+    const auto n = ::write(fd, ptr, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Could not write output!");
+    }
+    ptr += n;
+    len -= n;
+  }
+}
+
+}  // namespace output
+
+/** Growable buffer of formatted output.
+ */
+class OutputBlock {
+    std::vector<char> data;
+    std::size_t len;
+
+    char * reserve(std::size_t n) {
+      if (len + n > data.size()) {
+        data.resize(2 * (len + n));
+      }
+      return data.data() + len;
+    }
+
+  public:
+    explicit OutputBlock(std::size_t capacity = 1 << 12)
+      : data(capacity), len(0) {}
+
+    /** Appends value followed by sep.
+     */
+    void put(uint64_t value, char sep = '\n') {
+      char digits[output::max_digits];
+      const auto end = digits + output::max_digits;
+      const auto first = output::format_backwards(value, end);
+      const std::size_t n = end - first;
+      auto ptr = reserve(n + 1);
+      std::memcpy(ptr, first, n);
+      ptr[n] = sep;
+      len += n + 1;
+    }
+
+    void put(const char * chars, std::size_t n) {
+      std::memcpy(reserve(n), chars, n);
+      len += n;
+    }
+
+    const char * begin() const { return data.data(); }
+    std::size_t size() const { return len; }
+    void clear() { len = 0; }
+};
+
+/** Output buffer flushed to a file descriptor with write(2).
+ *  put() is for a single producer thread, commit() may be called
+ *  from any number of threads.
+ */
+class OutputSink {
+    const int fd;
+    const std::size_t threshold;
+    OutputBlock buffer;
+
+    std::mutex mutex;
+    std::size_t next_block;
+    std::map<std::size_t, OutputBlock> pending;
+
+    void check() {
+      if (buffer.size() >= threshold) {
+        flush();
+      }
+    }
+
+  public:
+    explicit OutputSink(int ofd = 1, std::size_t size = 1 << 20)
+      : fd(ofd), threshold(size), buffer(size + output::max_digits + 1),
+        next_block(0) {}
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    ~OutputSink() {
+      try {
+        flush();
+      } catch (...) {
+      }
+    }
+
+    void put(uint64_t value, char sep = '\n') {
+      buffer.put(value, sep);
+      check();
+    }
+
+    void put(const char * chars, std::size_t n) {
+      buffer.put(chars, n);
+      check();
+    }
+
+    void flush() {
+      output::write_all(fd, buffer.begin(), buffer.size());
+      buffer.clear();
+    }
+
+    /** Writes block number index after all blocks with smaller indices,
+     *  starting from 0. Blocks arriving early are kept until then.
+     */
+    void commit(std::size_t index, OutputBlock block) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (index != next_block) {
+        pending.emplace(index, std::move(block));
+        return;
+      }
+      put(block.begin(), block.size());
+      ++next_block;
+      auto it = pending.begin();
+      while (it != pending.end() && it->first == next_block) {
+        put(it->second.begin(), it->second.size());
+        it = pending.erase(it);
+        ++next_block;
+      }
+    }
+};
+
+#endif  // OUTPUT_HPP
@@ -0,0 +1,236 @@
+/** Streaming tokenizer for whitespace separated unsigned integers,
+ *  shared by the stdin readers.
+ *
+ *  Digit runs are found with SIMD byte masks (AVX2, or SSE2 otherwise)
+ *  and converted 8 digits at a time with SWAR arithmetic on a 64 bit
+ *  word. Anything that is not a digit separates integers, so signs are
+ *  skipped like any other character.
+ *
+ *  Check out:
+ *    - https://lemire.me/blog/2022/01/21/swar-explained-parsing-eight-digits/
+ */
+
+#ifndef TOKENIZER_HPP
+#define TOKENIZER_HPP
+
+#include <cstddef>        // std::size_t
+#include <cstdint>        // uint64_t
+#include <cstring>        // std::memcpy, std::memmove, std::memset
+#include <istream>        // std::istream
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>    // _mm256_*, _mm_*
+#endif
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "tokenizer.hpp assumes a little endian target."
+#endif
+
+namespace tokenizer {
+
+/** Bytes that must be readable past the end of the data.
+ */
+constexpr std::size_t padding = 32;
+
+#if defined(__AVX2__)
+constexpr std::size_t lanes = 32;
+
+/** Bit k is set iff p[k] is a digit.
+ */
+inline uint64_t digit_mask(const char * p) {
+  const __m256i x = _mm256_sub_epi8(
+                      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)),
+                      _mm256_set1_epi8('0'));
+  const __m256i d = _mm256_cmpeq_epi8(
+                      _mm256_min_epu8(x, _mm256_set1_epi8(9)), x);
+  return uint32_t(_mm256_movemask_epi8(d));
+}
+#elif defined(__SSE2__)
+constexpr std::size_t lanes = 16;
+
+inline uint64_t digit_mask(const char * p) {
+  const __m128i x = _mm_sub_epi8(
+                      _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)),
+                      _mm_set1_epi8('0'));
+  const __m128i d = _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(9)), x);
+  return uint32_t(_mm_movemask_epi8(d));
+}
+#else
+constexpr std::size_t lanes = 8;
+
+inline uint64_t digit_mask(const char * p) {
+  uint64_t mask = 0;
+  for (std::size_t k = 0; k < lanes; k++) {
+    mask |= uint64_t(unsigned(p[k] - '0') < 10) << k;
+  }
+  return mask;
+}
+#endif
+
+constexpr uint64_t all_lanes = (uint64_t(1) << lanes) - 1;
+
+/** First digit in [p, end), or end. Reads up to padding bytes past end.
+ */
+inline const char * skip_to_digit(const char * p, const char * end) {
+  for (; p < end; p += lanes) {
+    const uint64_t mask = digit_mask(p);
+    if (mask) {
+      p += __builtin_ctzll(mask);
+      return p < end ? p : end;
+    }
+  }
+  return end;
+}
+
+/** First non digit in [p, end), or end. Reads up to padding bytes past end.
+ */
+inline const char * digit_run_end(const char * p, const char * end) {
+  for (; p < end; p += lanes) {
+    const uint64_t mask = ~digit_mask(p) & all_lanes;
+    if (mask) {
+      p += __builtin_ctzll(mask);
+      return p < end ? p : end;
+    }
+  }
+  return end;
+}
+
+/** Skips up to n integers in [p, end) without converting them, by
+ *  counting the digit run starts of each block. Subtracts the number
+ *  skipped from n and returns the end of the last one, or end if there
+ *  are fewer. p must not point into the middle of an integer.
+ *  Reads up to padding bytes past end.
+ */
+inline const char * skip_integers(const char * p, const char * end,
+                                  uint64_t& n) {
+  uint64_t carry = 0;
+  for (; n && p < end; p += lanes) {
+    uint64_t mask = digit_mask(p);
+    const std::size_t avail = end - p;
+    if (avail < lanes) {
+      mask &= (uint64_t(1) << avail) - 1;
+    }
+    uint64_t starts = mask & ~((mask << 1) | carry);
+    carry = (mask >> (lanes - 1)) & 1;
+    const auto num_starts = uint64_t(__builtin_popcountll(starts));
+    if (num_starts < n) {
+      n -= num_starts;
+      continue;
+    }
+    // the last integer to skip starts in this block
+    for (; n > 1; n--) {
+      starts &= starts - 1;
+    }
+    n = 0;
+    return digit_run_end(p + __builtin_ctzll(starts), end);
+  }
+  return n ? end : p;
+}
+
+/** Converts 8 ASCII digits, the first in the lowest byte.
+ */
+inline uint64_t parse_eight(uint64_t chunk) {
+  constexpr uint64_t mask = 0x000000FF000000FF;
+  constexpr uint64_t mul1 = 100 + (uint64_t(1000000) << 32);
+  constexpr uint64_t mul2 = 1 + (uint64_t(10000) << 32);
+  chunk -= 0x3030303030303030;
+  chunk = (chunk * 10) + (chunk >> 8);
+  return (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+}
+
+/** Value of the len digits at p. Reads up to 8 bytes past p + len,
+ *  which must be readable. Wraps around past 2^64 - 1.
+ */
+inline uint64_t parse_digits(const char * p, std::size_t len) {
+  uint64_t value = 0;
+  uint64_t chunk = 0;
+  const std::size_t head = len % 8;
+  if (head) {
+    // pad the head with leading '0' characters to 8 digits
+    std::memcpy(&chunk, p, sizeof(chunk));
+    chunk = (chunk << (8 * (8 - head)))
+            | (0x3030303030303030 >> (8 * head));
+    value = parse_eight(chunk);
+    p += head;
+    len -= head;
+  }
+  for (; len; len -= 8, p += 8) {
+    std::memcpy(&chunk, p, sizeof(chunk));
+    value = value * 100000000 + parse_eight(chunk);
+  }
+  return value;
+}
+
+}  // namespace tokenizer
+
+/** Reads unsigned integers from a stream, one large chunk at a time,
+ *  or from a string. Integers may cross chunk boundaries.
+ */
+class Tokenizer {
+    std::istream * is;
+    std::vector<char> buffer;
+    const char * ptr;
+    const char * end;
+
+    /** Moves [keep, end) to the front of the buffer and reads more after it.
+     *  Returns false if nothing could be read.
+     */
+    bool refill(const char * keep) {
+      if (!is || !*is) {
+        return false;
+      }
+      const std::size_t kept = end - keep;
+      const std::size_t capacity = buffer.size() - tokenizer::padding;
+      if (kept == capacity) {
+        return false;
+      }
+      std::memmove(buffer.data(), keep, kept);
+      is->read(buffer.data() + kept, capacity - kept);
+      const std::size_t len = is->gcount();
+      ptr = buffer.data();
+      end = ptr + kept + len;
+      std::memset(buffer.data() + kept + len, 0, tokenizer::padding);
+      return len > 0;
+    }
+
+  public:
+    explicit Tokenizer(std::istream& in, std::size_t size = 1 << 20)
+      : is(&in), buffer(size + tokenizer::padding, 0),
+        ptr(buffer.data()), end(buffer.data()) {}
+
+    explicit Tokenizer(const std::string& chars)
+      : is(nullptr), buffer(chars.begin(), chars.end()),
+        ptr(nullptr), end(nullptr) {
+      buffer.resize(chars.size() + tokenizer::padding, 0);
+      ptr = buffer.data();
+      end = ptr + chars.size();
+    }
+
+    /** Reads the next integer, returns false at the end of input.
+     */
+    bool next(uint64_t& value) {
+      ptr = tokenizer::skip_to_digit(ptr, end);
+      while (ptr == end) {
+        if (!refill(end)) {
+          return false;
+        }
+        ptr = tokenizer::skip_to_digit(ptr, end);
+      }
+      // the run may go on in the next chunk, refill moves it to the front
+      auto run = tokenizer::digit_run_end(ptr, end);
+      while (run == end) {
+        const bool more = refill(ptr);
+        run = tokenizer::digit_run_end(ptr, end);
+        if (!more) {
+          break;
+        }
+      }
+      value = tokenizer::parse_digits(ptr, run - ptr);
+      ptr = run;
+      return true;
+    }
+};
+
+#endif  // TOKENIZER_HPP
@@ -1,42 +1,22 @@
-#include <string>         // std::string
-#include <cctype>         // isdigit
 #include <vector>         // std::vector
-#include <cstdlib>        // strtoul
+#include <cstddef>        // std::size_t
 #include <cstdint>        // uint32_t
-#include <iostream>       // std::cout
+#include <cstdlib>        // strtoull
+#include <cstring>        // strlen
+#include <iostream>       // std::cin
+#include <utility>        // std::move, std::swap
+#include <algorithm>      // std::min, std::max
 #include <exception>      // std::runtime_error
 #include <type_traits>    // std::is_unsigned
 
+#include "mod_int.hpp"    // Barrett, DynamicBarrett
+#include "tokenizer.hpp"  // Tokenizer
+#include "output.hpp"     // OutputSink
+#include "lookup.hpp"     // GrowableLookup
+
 using value_type = uint32_t;
 static_assert(std::is_unsigned<value_type>(), "Value type is signed!");
 
-template <value_type n_max>
-class Lookup {
-  protected:
-    value_type lookup[n_max + 1];
-  public:
-    constexpr Lookup() : lookup() {}
-    constexpr value_type operator()(value_type i) const {
-      if (i > n_max) {
-        return 0;
-      }
-      return lookup[i];
-    }
-};
-
-template <value_type n_max>
-class Factorial : public Lookup<n_max> {
-  public:
-    constexpr Factorial(value_type modulo) : Lookup<n_max>() {
-      auto value = value_type(1);
-      Lookup<n_max>::lookup[0] = value_type(1);
-      for (auto i = value_type(1); i <= n_max; i++) {
-        value = (uint64_t(value) * uint64_t(i)) % modulo;
-        Lookup<n_max>::lookup[i] = value;
-      }
-    }
-};
-
 constexpr value_type mod_exp(
   value_type value, 
   value_type exponent, 
@@ -53,38 +33,273 @@ constexpr value_type mod_exp(
   return result;
 }
 
-template <value_type n_max>
-class InvFactorial : public Lookup<n_max> {
+/** Generator of i! and 1 / i! mod a prime, for GrowableLookup.
+ *  Each range continues from the last factorial and takes a single
+ *  mod_exp, the other inverses follow walking down: 1 / (i - 1)! = i / i!.
+ *  The table grows in whole grains, entries from the modulo on are
+ *  zero, as i! is, and never read.
+ */
+template <value_type modulo>
+class Factorials {
+    using Mod = Barrett<modulo>;
+    uint64_t factorial;
   public:
-    constexpr InvFactorial(value_type modulo) : Lookup<n_max>() {
-      Lookup<n_max>::lookup[0] = value_type(1);
-      auto value = value_type(1);
-      for (auto i = value_type(1); i <= n_max; i++) {
-        value = (uint64_t(value) * uint64_t(i)) % modulo;
-        Lookup<n_max>::lookup[i] = mod_exp(value, modulo - 2, modulo);
+    struct Entry {
+      value_type factorial;
+      value_type inv_factorial;
+    };
+
+    Factorials() : factorial(1) {}
+
+    void operator()(Entry * out, std::size_t first, std::size_t count) {
+      const std::size_t valid = first < modulo
+                                ? std::min<std::size_t>(count, modulo - first)
+                                : 0;
+      for (std::size_t k = valid; k < count; k++) {
+        out[k] = Entry{0, 0};
+      }
+      if (!valid) {
+        return;
+      }
+      for (std::size_t k = 0; k < valid; k++) {
+        if (first + k) {
+          factorial = Mod::mul(factorial, first + k);
+        }
+        out[k].factorial = value_type(factorial);
+      }
+      uint64_t inv = mod_exp(value_type(factorial), modulo - 2, modulo);
+      for (std::size_t k = valid; k-- > 0; ) {
+        out[k].inv_factorial = value_type(inv);
+        inv = Mod::mul(inv, first + k);
       }
     }
 };
 
-template <value_type n_max>
+/** (n choose k) mod a prime, from factorials computed up to the
+ *  largest n asked for so far, so n must stay below the modulo.
+ */
+template <value_type modulo>
 class Binomial {
-    Factorial<n_max> factorial;
-    InvFactorial<n_max> inv_factorial;
-    const value_type modulo;
+    using Mod = Barrett<modulo>;
+    GrowableLookup<typename Factorials<modulo>::Entry, 
+                   Factorials<modulo>> table;
   public:
-    constexpr Binomial(value_type mod) 
-      : modulo(mod), factorial(mod), inv_factorial(mod) {}
-    constexpr value_type operator()(value_type n, value_type k) const {
+    /** Computes the factorials for all n < n_max at once,
+     *  n >= modulo is out of range anyway.
+     */
+    void reserve(uint64_t n_max) {
+      table.reserve(std::min(n_max, uint64_t(modulo)));
+    }
+
+    static uint64_t mul(uint64_t left, uint64_t right) {
+      return Mod::mul(left, right);
+    }
+
+    static uint64_t reduce(uint64_t x) { return Mod::reduce(x); }
+
+    value_type operator()(uint64_t n, uint64_t k) {
       if (n < k) {
         return 0;
       }
-      uint64_t result = uint64_t(factorial(n)) * uint64_t(inv_factorial(k));
-      result = (result % modulo) * uint64_t(inv_factorial(n - k));
-      return result % modulo;
+      if (n >= modulo) {
+        throw std::runtime_error("Binomial argument out of range!");
+      }
+      if (n >= table.size()) {
+        table.reserve(std::size_t(n) + 1);
+      }
+      const auto& entry = table.get(n);
+      uint64_t result = Mod::mul(entry.factorial, table.get(k).inv_factorial);
+      return Mod::mul(result, table.get(n - k).inv_factorial);
+    }
+};
+
+/** (n choose k) mod any modulo below 2^32, for any 64 bit n, with
+ *  tables of size p^e per prime power factor p^e of the modulo.
+ *
+ *  Each factor is handled on its own and the residues are combined
+ *  via CRT. For e = 1, Lucas's theorem multiplies the binomials of the
+ *  base p digits, from i! and 1 / i! mod p for i < p. For e > 1,
+ *    n! = p^v(n) N(n) N(n / p) N(n / p^2) ... (mod p^e),
+ *  where N(x) is the product of j <= x with p not dividing j, which is
+ *  g(p^e - 1) ^ (x / p^e) g(x mod p^e) with the table g of such
+ *  products below p^e. The binomial is p^v with v the number of carries
+ *  adding k and n - k in base p (Kummer), times the unit parts.
+ *
+ *  Check out:
+ *    - https://en.wikipedia.org/wiki/Lucas%27s_theorem
+ *    - https://en.wikipedia.org/wiki/Kummer%27s_theorem
+ *    - Granville, Binomial coefficients modulo prime powers
+ */
+class LucasBinomial {
+    /** Largest p^e with a table, 2^26 entries take 256 MB as factorials
+     *  and inverses.
+     */
+    static constexpr uint64_t max_table = uint64_t(1) << 26;
+
+    struct Factor {
+      DynamicBarrett p;
+      DynamicBarrett pe;
+      unsigned e;
+      uint64_t crt;                     // 1 mod p^e, 0 mod the other factors
+      std::vector<value_type> table;    // i! mod p, or g(i) mod p^e
+      std::vector<value_type> inv;      // 1 / i! mod p, if e = 1
+    };
+
+    DynamicBarrett m;
+    std::vector<Factor> factors;
+
+    static uint64_t pow_mod(uint64_t value, uint64_t exponent,
+                            const DynamicBarrett& mod) {
+      uint64_t result = mod.reduce(1);
+      value = mod.reduce(value);
+      while (exponent) {
+        if (exponent % 2) {
+          result = mod.mul(result, value);
+        }
+        value = mod.mul(value, value);
+        exponent /= 2;
+      }
+      return result;
+    }
+
+    /** Inverse of a unit mod modulo, by the extended Euclidean algorithm.
+     */
+    static uint64_t inv_mod(uint64_t value, uint64_t modulo) {
+      int64_t a = int64_t(value % modulo), b = int64_t(modulo);
+      int64_t x = 1, y = 0;
+      while (b) {
+        const auto q = a / b;
+        a -= q * b;
+        std::swap(a, b);
+        x -= q * y;
+        std::swap(x, y);
+      }
+      return uint64_t((x % int64_t(modulo) + int64_t(modulo)) % int64_t(modulo));
+    }
+
+    static uint64_t lucas(const Factor& f, uint64_t n, uint64_t k) {
+      uint64_t result = f.p.reduce(1);
+      while (k) {
+        uint64_t ni = 0;
+        uint64_t ki = 0;
+        n = f.p.divide(n, ni);
+        k = f.p.divide(k, ki);
+        if (ki > ni) {
+          return 0;
+        }
+        result = f.p.mul(result, f.table[ni]);
+        result = f.p.mul(f.p.mul(result, f.inv[ki]), f.inv[ni - ki]);
+      }
+      return result;
+    }
+
+    /** N(x) mod p^e and x / p, see above. g(p^e - 1) is -1, or 1 for
+     *  p = 2, e > 2, so its power is a sign.
+     */
+    static uint64_t unit_part(const Factor& f, uint64_t& x) {
+      uint64_t low = 0;
+      const bool odd = f.pe.divide(x, low) % 2;
+      const uint64_t g = f.table[low];
+      uint64_t rest = 0;
+      x = f.p.divide(x, rest);
+      return odd && f.table[f.pe.modulo() - 1] != 1 ? f.pe.modulo() - g : g;
+    }
+
+    static uint64_t prime_power(const Factor& f, uint64_t n, uint64_t k) {
+      uint64_t r = n - k;
+      uint64_t num = 1;
+      uint64_t den = 1;
+      uint64_t v = 0;
+      while (n) {
+        num = f.pe.mul(num, unit_part(f, n));
+        den = f.pe.mul(den, unit_part(f, k));
+        den = f.pe.mul(den, unit_part(f, r));
+        v += n - k - r;
+      }
+      if (v >= f.e) {
+        return 0;
+      }
+      const auto unit = f.pe.mul(num, inv_mod(den, f.pe.modulo()));
+      return f.pe.mul(pow_mod(f.p.modulo(), v, f.pe), unit);
+    }
+
+    static DynamicBarrett checked(uint64_t modulo) {
+      if (modulo < 2 || modulo >= (uint64_t(1) << 32)) {
+        throw std::runtime_error("Modulo out of range!");
+      }
+      return DynamicBarrett(modulo);
+    }
+
+  public:
+    explicit LucasBinomial(uint64_t modulo) : m(checked(modulo)), factors() {
+
+      // prime power factors by trial division
+      auto rest = modulo;
+      for (uint64_t p = 2; rest > 1; p++) {
+        if (p * p > rest) {
+          p = rest;
+        }
+        if (rest % p) {
+          continue;
+        }
+        unsigned e = 0;
+        uint64_t pe = 1;
+        while (rest % p == 0) {
+          rest /= p;
+          pe *= p;
+          e++;
+        }
+        if (pe > max_table) {
+          throw std::runtime_error("Modulo factor too large for tables!");
+        }
+        const auto other = modulo / pe;
+        const auto crt = other * inv_mod(other, pe) % modulo;
+        factors.push_back(Factor{DynamicBarrett(p), DynamicBarrett(pe),
+                                 e, crt, {}, {}});
+      }
+
+      for (auto& f : factors) {
+        const auto p = f.p.modulo();
+        const auto pe = f.pe.modulo();
+        f.table.resize(pe);
+        f.table[0] = 1;
+        if (f.e == 1) {
+          for (uint64_t i = 1; i < p; i++) {
+            f.table[i] = value_type(f.table[i - 1] * i % p);
+          }
+          f.inv.resize(p);
+          f.inv[p - 1] = value_type(inv_mod(f.table[p - 1], p));
+          for (uint64_t i = p - 1; i > 0; i--) {
+            f.inv[i - 1] = value_type(f.inv[i] * i % p);
+          }
+        } else {
+          for (uint64_t i = 1; i < pe; i++) {
+            f.table[i] = value_type(i % p ? f.table[i - 1] * i % pe
+                                          : f.table[i - 1]);
+          }
+        }
+      }
+    }
+
+    uint64_t mul(uint64_t left, uint64_t right) const {
+      return m.mul(left, right);
+    }
+
+    uint64_t reduce(uint64_t x) const { return m.reduce(x); }
+
+    uint64_t operator()(uint64_t n, uint64_t k) const {
+      if (n < k) {
+        return 0;
+      }
+      uint64_t result = 0;
+      for (const auto& f : factors) {
+        const auto r = f.e == 1 ? lucas(f, n, k) : prime_power(f, n, k);
+        result = m.reduce(result + r * f.crt);
+      }
+      return result;
     }
 };
 
-constexpr value_type NMAX = value_type(100000);
 constexpr value_type MODULO = value_type(1000000007);
 
 constexpr bool is_prime(value_type x) {
@@ -102,75 +317,70 @@ constexpr bool is_prime(value_type x) {
 static_assert(is_prime(MODULO), "MODULO is not prime!");
 static_assert((MODULO & ~uint32_t(1 << 31)) == MODULO, "MODULO not 31 bit!");
 
-// This needs a lot of RAM to compile for large NMAX
-static constexpr Binomial<NMAX> binomial(MODULO);
-
-std::vector<int64_t> parse_stdin() {
-
-  // get stream length
-  std::cin.seekg(0, std::ios_base::end);
-  std::size_t len = std::cin.tellg();
-  std::cin.seekg(0, std::ios_base::beg);
-
-  // allocate for reading & reserve for output
-  std::string chars(len, ' ');
-  std::vector<int64_t> out;
-  out.reserve(len);
-
-  // read
-  std::cin.read(static_cast<char *>(&chars[0]), len);
-
-  // parse
-  auto ptr = chars.data();
-  const auto end = chars.data() + len;
-  while (ptr != end) {
-
-    // skip until next digit
-    while (!isdigit(*ptr)) {
-      if (ptr == end) {
-        goto parse_stdin_end;
-      }
-      ++ptr;
-    }
-
-    // try parsing to uint32_t
-    char * e_ptr = nullptr;
-    auto value = strtoll(ptr, &e_ptr, 10);
-
-    // check parse was successful
-    if (e_ptr == ptr) {
-      throw std::runtime_error("Error: Could not parse integer from input!");
-    }
-    ptr = e_ptr;
+std::vector<uint64_t> parse_stdin() {
+  Tokenizer tokens(std::cin);
+  std::vector<uint64_t> out;
+  uint64_t value = 0;
+  while (tokens.next(value)) {
     out.push_back(value);
-
   }
-  parse_stdin_end:
   return out;
 }
 
-inline value_type composition(value_type n, value_type c) {
-  static constexpr value_type lookup[] = {0, 1};
+template <typename Binom>
+inline uint64_t composition(Binom& binomial, uint64_t n, uint64_t c) {
+  static constexpr uint64_t lookup[] = {0, 1};
   return n == 0 ? lookup[c == 0] : binomial(n - 1, c - 1);
 }
 
-inline value_type formula(value_type n, value_type m, value_type c) {
-  uint64_t w = composition(n - m, c);
-  uint64_t x = (w * uint64_t(composition(m, c - 1))) % MODULO;
-  uint64_t y = (w * uint64_t(composition(m, c + 1))) % MODULO;
-  uint64_t z = (w * uint64_t(composition(m, c))) % MODULO;
-  z = (z * 2) % MODULO;
-  return (((x + y) % MODULO) + z) % MODULO;
+template <typename Binom>
+inline uint64_t formula(Binom& binomial, uint64_t n, uint64_t m, uint64_t c) {
+  uint64_t w = composition(binomial, n - m, c);
+  uint64_t x = binomial.mul(w, composition(binomial, m, c - 1));
+  uint64_t y = binomial.mul(w, composition(binomial, m, c + 1));
+  uint64_t z = binomial.mul(w, composition(binomial, m, c));
+  return binomial.reduce(x + y + 2 * z);
 }
 
+/** Usage: a.out [MODULO] < input
+ *  Without MODULO the answers are mod 10^9 + 7, from factorial tables
+ *  up to the largest n of the input. With MODULO, below 2^32, they come
+ *  from LucasBinomial, for any n below 2^64 and tables of size p^e
+ *  per prime power factor of MODULO.
+ */
 int main(int argc, char** argv) {
+  OutputSink out;
   try {
+    if (argc > 2) {
+      throw std::runtime_error("Usage: a.out [MODULO] < input");
+    }
     auto input = parse_stdin();
-    for (size_t i = 1; i < input.size(); i += 3) {
-      std::cout << formula(input[i], input[i + 1], input[i + 2]) << "\n";
+    if (argc > 1) {
+      char * e_ptr = nullptr;
+      const auto modulo = strtoull(argv[1], &e_ptr, 10);
+      if (e_ptr == argv[1] || *e_ptr) {
+        throw std::runtime_error("Could not parse MODULO!");
+      }
+      const LucasBinomial binomial(modulo);
+      for (size_t i = 1; i + 2 < input.size(); i += 3) {
+        out.put(formula(binomial, input[i], input[i + 1], input[i + 2]));
+      }
+      return 0;
+    }
+
+    Binomial<MODULO> binomial;
+    // factorials up to the largest n of the batch, in one go
+    uint64_t n_top = 0;
+    for (size_t i = 1; i + 2 < input.size(); i += 3) {
+      n_top = std::max(n_top, input[i]);
+    }
+    binomial.reserve(n_top + 1);
+    for (size_t i = 1; i + 2 < input.size(); i += 3) {
+      out.put(formula(binomial, input[i], input[i + 1], input[i + 2]));
     }
   } catch(std::exception& exception) {
-    std::cout << exception.what() << "\n";
+    out.put(exception.what(), strlen(exception.what()));
+    out.put("\n", 1);
   }
   return 0;
 }
\ No newline at end of file
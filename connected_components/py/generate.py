@@ -0,0 +1,35 @@
+import sys
+import random
+import argparse
+
+def queries(rng, num_queries, n_max):
+  '''
+    Yields queries n m c with 1 <= m < n <= n_max and 0 <= c <= m + 1.
+  '''
+  for _ in range(num_queries):
+    n = rng.randint(2, n_max)
+    m = rng.randint(1, n - 1)
+    c = rng.randint(0, m + 1)
+    yield '{} {} {}\n'.format(n, m, c)
+
+def main():
+  parser = argparse.ArgumentParser(description='Writes a seeded query file.')
+  parser.add_argument('--queries', type=int, default=10 ** 6)
+  parser.add_argument('--nmax', type=int, default=10 ** 5,
+                      help='maximum n')
+  parser.add_argument('--seed', type=int, default=0)
+  args = parser.parse_args()
+
+  rng = random.Random(args.seed)
+  out = sys.stdout
+  out.write('{}\n'.format(args.queries))
+  batch = []
+  for query in queries(rng, args.queries, args.nmax):
+    batch.append(query)
+    if len(batch) == 1 << 16:
+      out.write(''.join(batch))
+      batch = []
+  out.write(''.join(batch))
+
+if __name__ == '__main__':
+  main()
@@ -1,3 +1,5 @@
+import math
+import random
 import subprocess
 import numpy as np
 from sympy import *
@@ -47,6 +49,46 @@ def process_file(file_path):
   x = np.fromfile(file_path, dtype=int, sep=' ')[1:].reshape(-1, 3)
   return [(simulation(*y), analytical_formula(*y)) for y in x.tolist()]
 
+def exact_formula(N, M, C, modulo):
+  '''
+    The formula on exact integers mod modulo, for any size of N
+  '''
+  def comp(n, k):
+    if n == 0:
+      return 1 if k == 0 else 0
+    return math.comb(n - 1, k - 1) if k >= 1 else 0
+  w = comp(N - M, C)
+  return w * (comp(M, C - 1) + 2 * comp(M, C) + comp(M, C + 1)) % modulo
+
+def modulo_cases(seed=0):
+  '''
+    Seeded queries for ./a.out MODULO, small ones and ones with
+    n up to 10^18, where only the Lucas/CRT backend applies
+  '''
+  rng = random.Random(seed)
+  cases = []
+  for _ in range(100):
+    n = rng.randint(2, rng.choice([20, 2000, 10 ** 18]))
+    m = rng.randint(1, n - 1)
+    c = rng.randint(0, min(m + 1, 7))
+    cases.append((n, m, c))
+  return cases
+
+def check_modulo():
+  '''
+    Checks the composite, prime power and squarefree moduli
+    against exact binomials
+  '''
+  cases = modulo_cases()
+  input_str = '{}\n'.format(len(cases))
+  input_str += ''.join('{} {} {}\n'.format(*y) for y in cases)
+  for modulo in [12, 1024, 3 ** 10, 2310, 720720, 999983]:
+    cpp_test = subprocess.check_output(['./a.out', str(modulo)],
+                                       input=input_str.encode())
+    cpp_test = [int(x) for x in cpp_test.split()]
+    expected = [exact_formula(*y, modulo) for y in cases]
+    assert cpp_test == expected, 'Cpp test Failed, MODULO {}'.format(modulo)
+
 if __name__ == '__main__':
   file_path = './data/input.txt'
   test = np.array(process_file(file_path))
@@ -54,4 +96,5 @@ if __name__ == '__main__':
   cpp_test = subprocess.check_output(run_str, shell=True)
   cpp_test = np.fromstring(cpp_test, dtype=int, sep='\n')
   assert (test[:, 0] == test[:, 1]).all(), 'Test failed'
-  assert (test[:, 0] == cpp_test).all(), 'Cpp test Failed'
\ No newline at end of file
+  assert (test[:, 0] == cpp_test).all(), 'Cpp test Failed'
+  check_modulo()
@@ -0,0 +1,18 @@
+import random
+import argparse
+
+def main():
+  parser = argparse.ArgumentParser(
+    description='Prints a seeded count vector, pass it as a.out arguments.')
+  parser.add_argument('--length', type=int, default=8)
+  parser.add_argument('--min', type=int, default=2)
+  parser.add_argument('--max', type=int, default=5)
+  parser.add_argument('--seed', type=int, default=0)
+  args = parser.parse_args()
+
+  rng = random.Random(args.seed)
+  counts = [rng.randint(args.min, args.max) for _ in range(args.length)]
+  print(' '.join(map(str, counts)))
+
+if __name__ == '__main__':
+  main()
@@ -1,45 +1,39 @@
 #include <string>       // std::string
 #include <vector>       // std::vector
-#include <chrono>       // std::chrono
+#include <random>       // std::mt19937_64
 #include <cstdint>      // int64_t
-#include <cstdlib>      // std::strtoll
-#include <iostream>     // std::cout
+#include <cctype>       // isdigit, isspace
+#include <iostream>     // std::cout, std::cerr
 #include <algorithm>    // std::swap
 #include <exception>    // std exception
 #include <stdexcept>    // std::runtime_error
 
-/** Wrapper around std::chrono
- *
- */
-template<typename Type> 
-class Timer {
-    using Clock = std::chrono::high_resolution_clock;
-    using TimePoint = Clock::time_point;
-    TimePoint tick_point;
-  public:
-    Timer() { tick_point = Clock::now(); }
-    void tic() { tick_point = Clock::now(); }
-    Type toc() { 
-      using namespace std::chrono;
-      return duration_cast<duration<Type>>(Clock::now() - tick_point).count(); 
-    }
-};
+#ifdef __AVX2__
+#include <immintrin.h> // _mm256_*
+#endif
+
+#include "tokenizer.hpp" // Tokenizer
+#include "bench.hpp"     // Timer, Benchmark, do_not_optimize
 
 /** Basic positive int parser
  *
  */
 inline size_t parse_positive_int(const char * argv) {
   using namespace std;
-  char * e_ptr;
-  int64_t ans = strtoll(argv, &e_ptr, 10);
-  if(e_ptr == argv) {
-    auto msg = string("Could not parse one of the values.");
-    throw(runtime_error(msg));
+  const char * ptr = argv;
+  while(isspace(*ptr) || *ptr == '+') {
+    ++ptr;
   }
-  if(ans < 0LL) {
+  if(*ptr == '-') {
     auto msg = string("All values must be positive");
     throw(runtime_error(msg));
   }
+  uint64_t ans = 0ULL;
+  Tokenizer tokens(ptr);
+  if(!isdigit(*ptr) || !tokens.next(ans)) {
+    auto msg = string("Could not parse one of the values.");
+    throw(runtime_error(msg));
+  }
   return static_cast<size_t>(ans);
 }
 
@@ -59,10 +53,77 @@ std::vector<size_t> parse_args(int argc, char const * argv[]) {
   return ans;
 }
 
+/** Search tree statistics, disabled by default.
+ *  All members are no-ops, so the calls vanish from the search.
+ */
+template<size_t num_levels, bool enabled>
+class SearchStats {
+  public:
+    void node(size_t, size_t) noexcept {}
+    void leaf() noexcept {}
+    void set_estimate(double) noexcept {}
+    void print(std::ostream &) const {}
+};
+
+/** Search tree statistics, enabled via the Counter template flag.
+ *  Keeps per depth node counts and widths of the [xmin, xmax) range,
+ *  plus the number of leaf hits. Progress is reported to stderr
+ *  every 2^report_shift nodes, against the sampled tree size estimate.
+ */
+template<size_t num_levels>
+class SearchStats<num_levels, true> {
+    static constexpr size_t report_shift = 24ULL;
+    static constexpr size_t report_mask = (1ULL << report_shift) - 1ULL;
+
+    size_t nodes[num_levels];
+    size_t width_sum[num_levels];
+    size_t width_max[num_levels];
+    size_t visited;
+    size_t leaf_hits;
+    double estimate;
+
+  public:
+    SearchStats() : nodes(), width_sum(), width_max(),
+                    visited(0ULL), leaf_hits(0ULL), estimate(0.0) {}
+
+    void node(size_t depth, size_t width) noexcept {
+      nodes[depth]++;
+      width_sum[depth] += width;
+      width_max[depth] = width > width_max[depth] ? width : width_max[depth];
+      if(!(++visited & report_mask)) {
+        std::cerr << "visited " << visited << " nodes";
+        if(estimate > 0.0) {
+          std::cerr << " of ~" << estimate
+                    << " (" << 100.0 * visited / estimate << "%)";
+        }
+        std::cerr << "\n";
+      }
+    }
+
+    void leaf() noexcept {
+      ++visited;
+      ++leaf_hits;
+    }
+
+    void set_estimate(double value) noexcept { estimate = value; }
+
+    void print(std::ostream & os) const {
+      os << "depth nodes mean_width max_width\n";
+      for(size_t d = 0ULL; d < num_levels; d++) {
+        if(nodes[d]) {
+          os << d << " " << nodes[d] << " "
+             << double(width_sum[d]) / nodes[d] << " " << width_max[d] << "\n";
+        }
+      }
+      os << "leaf hits: " << leaf_hits << "\n";
+      os << "nodes visited: " << visited << "\n";
+    }
+};
+
 /** Class responsible for the actual computation
  *
  */
-template<size_t max_num_counts>
+template<size_t max_num_counts, bool instrumented = false>
 class Counter {
   //private:
 
@@ -82,6 +143,11 @@ class Counter {
     static constexpr size_t max_num_triu = max_num_counts 
                                             * (max_num_counts + 1ULL) / 2ULL;
 
+    /** Offset of the input row in the arrays.
+     *  
+     */
+    static constexpr size_t pad = max_num_counts + 1ULL;
+
     /** Arrays for keeping track of the matrix and the set of possible
      *  entry values.
      */
@@ -89,6 +155,16 @@ class Counter {
     size_t counts[max_num_triu + max_num_counts + 1ULL];
     size_t ccounts[max_num_triu + max_num_counts + 1ULL];
 
+    /** Start of the first searched row, used to get the depth of a node.
+     *
+     */
+    const size_t * root;
+
+    /** Optional search tree counters, see SearchStats.
+     *
+     */
+    SearchStats<max_num_triu + 1ULL, instrumented> stats;
+
     /** Shorthand for pair minimum.
      *  
      */
@@ -110,6 +186,50 @@ class Counter {
               + (a + 1ULL) * (b + 1ULL);
     }
 
+    /** Derives the bounds of the next row, of length n, 
+     *  from the completed row of length n + 1 at xptr.
+     *  AVX2 has no unsigned 64 bit min, max or saturating subtract,
+     *  so 4 lanes at a time they are built from the signed compare
+     *  with the sign bits flipped, which orders values as unsigned.
+     */
+    static void next_bounds(
+      size_t n,
+      const size_t * xptr,
+      size_t * cptr,
+      size_t * ccptr
+    ) noexcept {
+      const size_t * y = xptr - (n + 1ULL);
+      size_t k = 0ULL;
+#ifdef __AVX2__
+      static_assert(sizeof(size_t) == sizeof(int64_t), "size_t not 64 bit!");
+      const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+      for(; k + 4ULL <= n; k += 4ULL) {
+        const __m256i a = _mm256_loadu_si256(
+                            reinterpret_cast<const __m256i *>(xptr + k));
+        const __m256i b = _mm256_loadu_si256(
+                            reinterpret_cast<const __m256i *>(xptr + k + 1ULL));
+        const __m256i yv = _mm256_loadu_si256(
+                             reinterpret_cast<const __m256i *>(y + k));
+        const __m256i xsum = _mm256_add_epi64(a, b);
+        const __m256i pos = _mm256_cmpgt_epi64(_mm256_xor_si256(xsum, sign),
+                                               _mm256_xor_si256(yv, sign));
+        const __m256i a_gt_b = _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign),
+                                                  _mm256_xor_si256(b, sign));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(ccptr + k),
+                            _mm256_and_si256(pos, _mm256_sub_epi64(xsum, yv)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(cptr + k),
+                            _mm256_blendv_epi8(a, b, a_gt_b));
+      }
+#endif
+      for(size_t j = k; j < n; j++) {
+        size_t xsum = *(xptr + j) + *(xptr + j + 1ULL); 
+        *(ccptr + j) = xsum > *(y + j) ? (xsum - *(y + j)) : 0ULL;
+      }
+      for(size_t j = k; j < n; j++) {
+        *(cptr + j) = min(*(xptr + j), *(xptr + j + 1ULL));
+      }
+    }
+
     /** Recursive routine running the calculation.
      *  
      */
@@ -126,6 +246,7 @@ class Counter {
         if(i < n) {
           size_t xmin = *(ccptr + i);
           size_t xmax = *(cptr + i) + 1ULL;
+          stats.node((xptr - root) + i, xmax > xmin ? xmax - xmin : 0ULL);
           for(size_t j = xmin; j < xmax; j++) {
             *(xptr + i) = j;
             sum += num_unique_cfg(i + 1ULL, n, xptr, cptr, ccptr);
@@ -135,46 +256,132 @@ class Counter {
           size_t m = n--;
           ccptr += m;
           cptr += m;
-          for(
-            size_t *x = xptr, *y = xptr - m, *cc = ccptr, j = 0ULL;
-            j < n; 
-            x++, y++, cc++, j++
-          ) {
-            size_t xsum = *(x) + *(x + 1ULL); 
-            *(cc) = xsum > *(y) ? (xsum - *(y)) : 0ULL;
-          }
-          for(size_t *x = xptr, *c = cptr, j = 0ULL; j < n; x++, c++, j++) {
-            *(c) = min(*(x), *(x + 1ULL));
-          }
+          next_bounds(n, xptr, cptr, ccptr);
           return num_unique_cfg(0ULL, n, xptr + m, cptr, ccptr);
         }
       } 
       else if(n == 1ULL) {
+        stats.leaf();
         return (*(cptr) + 1ULL) - *(ccptr);
       }
       else {
+        stats.leaf();
         return 1ULL;
       }
     }
 
-  public:
-    Counter() {
-      for(auto & val: cfg) {
-        val = 0ULL;
-      }
-      for(auto & val: counts) {
-        val = 0ULL;
+    /** Iterative version of num_unique_cfg, visiting the same nodes in
+     *  the same order. The rows are contiguous, so the search is a walk
+     *  over positions p of the arrays, with the values on the path kept
+     *  in xptr as the stack. The last row of length 1 is not searched:
+     *  the last position of each row of length 2 adds up the leaves of
+     *  its whole range in one loop.
+     */
+    size_t num_unique_cfg_iterative(
+      size_t n, 
+      size_t * xptr, 
+      size_t * cptr,
+      size_t * ccptr
+    ) noexcept {
+      if(n < 2ULL) {
+        stats.leaf();
+        return n ? (*(cptr) + 1ULL) - *(ccptr) : 1ULL;
       }
-      for(auto & val: ccounts) {
-        val = 0ULL;
+      size_t sum = 0ULL;
+      size_t s = 0ULL;    // start of the current row
+      size_t len = n;     // length of the current row
+      size_t p = 0ULL;    // current position
+      while(true) {
+        size_t xmin = *(ccptr + p);
+        size_t xmax = *(cptr + p) + 1ULL;
+        stats.node(p, xmax > xmin ? xmax - xmin : 0ULL);
+        *(xptr + p) = xmin;
+        bool advance = xmin < xmax;
+        if(advance && len == 2ULL && p == s + 1ULL) {
+          const size_t x0 = *(xptr + s);
+          const size_t y0 = *(xptr + s - 2ULL);
+          for(size_t j = xmin; j < xmax; j++) {
+            stats.leaf();
+            const size_t xsum = x0 + j;
+            sum += (min(x0, j) + 1ULL) - (xsum > y0 ? xsum - y0 : 0ULL);
+          }
+          advance = false;
+        }
+        // back to the last position with values left
+        while(!advance) {
+          if(p == s) {
+            if(!s) {
+              return sum;
+            }
+            len++;
+            s -= len;
+          }
+          p--;
+          advance = *(xptr + p) < *(cptr + p);
+          *(xptr + p) += advance;
+        }
+        // on to the next position, deriving the next row at a row end
+        if(p + 1ULL == s + len) {
+          next_bounds(len - 1ULL, xptr + s, cptr + s + len, ccptr + s + len);
+          s += len;
+          len--;
+        }
+        p++;
       }
     }
 
-    /** Entry point for the calculation.
+    /** Result of a single random probe down the search tree.
      *  
      */
-    size_t operator()(const std::vector<size_t> & values) {
-      static constexpr size_t pad = max_num_counts + 1ULL;
+    struct Probe {
+      double nodes;
+      double count;
+    };
+
+    /** Knuth's random probe: follows one uniformly chosen branch per level,
+     *  weighting by the branching factors seen so far. Averaged over many
+     *  probes, this is an unbiased estimate of the number of nodes the
+     *  search visits and of its result.
+     */
+    Probe probe(
+      size_t i, 
+      size_t n, 
+      size_t * xptr, 
+      size_t * cptr,
+      size_t * ccptr,
+      std::mt19937_64 & rng
+    ) noexcept {
+      if(n > 1ULL) {
+        if(i < n) {
+          size_t xmin = *(ccptr + i);
+          size_t xmax = *(cptr + i) + 1ULL;
+          if(xmax <= xmin) {
+            return {1.0, 0.0};
+          }
+          const size_t width = xmax - xmin;
+          *(xptr + i) = xmin + rng() % width;
+          Probe sub = probe(i + 1ULL, n, xptr, cptr, ccptr, rng);
+          return {1.0 + width * sub.nodes, width * sub.count};
+        } else {
+          size_t m = n--;
+          ccptr += m;
+          cptr += m;
+          next_bounds(n, xptr, cptr, ccptr);
+          return probe(0ULL, n, xptr + m, cptr, ccptr, rng);
+        }
+      } 
+      else if(n == 1ULL) {
+        return {1.0, double((*(cptr) + 1ULL) - *(ccptr))};
+      }
+      else {
+        return {1.0, 1.0};
+      }
+    }
+
+    /** Loads the input values into the first rows of the arrays.
+     *  Returns the number of counts.
+     */
+    size_t load(const std::vector<size_t> & values) {
       const size_t num_counts = values.size();
       if(num_counts > max_num_counts) {
         throw(std::runtime_error(
@@ -191,24 +398,103 @@ class Counter {
       for(size_t i = num_counts, j = 0ULL; j < num_counts - 1ULL; i++, j++) {
         counts[i + pad] = min(counts[j + pad], counts[j + 1ULL + pad]);
       }
+      root = &cfg[num_counts + pad];
+      return num_counts;
+    }
+
+  public:
+    Counter() : root(nullptr), stats() {
+      for(auto & val: cfg) {
+        val = 0ULL;
+      }
+      for(auto & val: counts) {
+        val = 0ULL;
+      }
+      for(auto & val: ccounts) {
+        val = 0ULL;
+      }
+    }
+
+    /** Estimates the search tree size with num_probes random probes,
+     *  printing the running estimate to stderr every report_every probes.
+     *  Returns the estimated number of nodes.
+     */
+    double estimate(
+      const std::vector<size_t> & values, 
+      size_t num_probes = 1ULL << 16,
+      size_t report_every = 1ULL << 12,
+      uint64_t seed = 0ULL
+    ) {
+      const size_t num_counts = load(values);
+      std::mt19937_64 rng(seed);
+      double nodes = 0.0;
+      double count = 0.0;
+      for(size_t k = 1ULL; k <= num_probes; k++) {
+        Probe p = probe(0ULL, 
+                        num_counts - 1ULL, 
+                        &cfg[num_counts + pad], 
+                        &counts[num_counts + pad],
+                        &ccounts[num_counts + pad],
+                        rng);
+        nodes += p.nodes;
+        count += p.count;
+        if(!(k % report_every) || k == num_probes) {
+          std::cerr << "probes: " << k 
+                    << ", estimated nodes: " << nodes / k
+                    << ", estimated count: " << count / k << "\n";
+        }
+      }
+      stats.set_estimate(nodes / num_probes);
+      return nodes / num_probes;
+    }
+
+    /** Entry point for the calculation.
+     *  
+     */
+    size_t operator()(const std::vector<size_t> & values) {
+      const size_t num_counts = load(values);
+#ifdef RECURSIVE
       return num_unique_cfg(0ULL, 
                             num_counts - 1ULL, 
                             &cfg[num_counts + pad], 
                             &counts[num_counts + pad],
                             &ccounts[num_counts + pad]);
+#else
+      return num_unique_cfg_iterative(num_counts - 1ULL, 
+                                      &cfg[num_counts + pad], 
+                                      &counts[num_counts + pad],
+                                      &ccounts[num_counts + pad]);
+#endif
     }
+
+    /** Prints the search tree counters, if enabled.
+     *  
+     */
+    void report(std::ostream & os) const { stats.print(os); }
 };
 
 /** Main routine
  *
  */
 int main(int argc, char const * argv[]) {
+#ifdef INSTRUMENT
+  Counter<64ULL, true> counter;
+#else
   Counter<64ULL> counter;
+#endif
   Timer<double> timer;
   try {
     std::vector<size_t> values = parse_args(argc, argv);
+#ifdef INSTRUMENT
+    counter.estimate(values);
+#endif
     std::cout << counter(values) << "\n";
     std::cout << timer.toc() << " seconds elapsed \n";
+    counter.report(std::cerr);
+#ifdef BENCH
+    Benchmark bench("recursive_counter", 1, 10);
+    bench.run([&]() { do_not_optimize(counter(values)); }).print(std::cerr);
+#endif
   } catch(std::exception & except) {
     std::cout << except.what() << "\n";
   }
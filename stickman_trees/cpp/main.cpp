@@ -1,98 +1,49 @@
-#include <string>         // std::string
-#include <cctype>         // isdigit
-#include <chrono>         // std::chrono::high_resolution_clock
+#include <thread>         // std::thread
+#include <vector>         // std::vector
 #include <cstdlib>        // strtoul
 #include <cstdint>        // uint32_t
-#include <iostream>       // std::cout
+#include <cstring>        // strcmp, strlen
+#include <iostream>       // std::cin
 #include <exception>      // std::runtime_error
 #include <algorithm>      // std::sort
 #include <functional>     // std::greater
 #include <type_traits>    // std::is_unsigned
 
+#include "mod_int.hpp"    // Barrett
+#include "tokenizer.hpp"  // Tokenizer
+#include "output.hpp"     // OutputSink
+#include "bench.hpp"      // Benchmark, do_not_optimize
+
 using value_type = uint64_t;
 static_assert(std::is_unsigned<value_type>(), "Value type is signed!");
 
-template<typename Type> 
-class Timer {
-    using Clock = std::chrono::high_resolution_clock;
-    using TimePoint = Clock::time_point;
-    TimePoint tick_point;
-  public:
-    Timer() { tick_point = Clock::now(); }
-    void tic() { tick_point = Clock::now(); }
-    Type toc() { 
-      using namespace std::chrono;
-      return duration_cast<duration<Type>>(Clock::now() - tick_point).count(); 
-    }
-};
-
-/** Totally safe function, nothing to see here.
- *
+/** Reads the number of nodes followed by the degree sequence into
+ *  array, sorted in descending order and terminated by a zero.
+ *  Returns the number of degrees read.
  */
-auto prepare_input(value_type *arr_start, value_type *arr_end) {
-
-  // get stream length
-  std::cin.seekg(0, std::ios_base::end);
-  std::size_t len = std::cin.tellg();
-  std::cin.seekg(0, std::ios_base::beg);
-
-  // allocate for reading & reserve for output
-  std::string chars(len, ' ');
-
-  // read
-  std::cin.read(static_cast<char *>(&chars[0]), len);
-
-  // parse
-  auto ptr = chars.data();
-  const auto end = chars.data() + len;
-
-  // skip first digit, can infer number of nodes from length of sequence
-  while (!isdigit(*ptr)) {
-    ++ptr;
-  }
+size_t prepare_input(std::vector<value_type>& array) {
 
-  // try parsing to uint32_t
-  char * e_ptr = nullptr;
-  size_t num_vals = strtoul(ptr, &e_ptr, 10);
+  Tokenizer tokens(std::cin);
 
-  // check parse was successful
-  if (e_ptr == ptr) {
+  // first value is the number of nodes
+  value_type num_vals = 0;
+  if (!tokens.next(num_vals)) {
     throw std::runtime_error("Error: Could not parse integer from input!");
   }
-  ptr = e_ptr;
-
-  auto arr_ptr = arr_start;
-
-  while (arr_ptr - arr_start < num_vals) {
-
-    // skip until next digit
-    while (!isdigit(*ptr)) {
-      if (ptr == end) {
-        goto parse_stdin_end;
-      }
-      ++ptr;
-    }
-
-    // try parsing to uint32_t
-    char * e_ptr = nullptr;
-    auto value = strtoul(ptr, &e_ptr, 10);
-
-    // check parse was successful
-    if (e_ptr == ptr) {
-      throw std::runtime_error("Error: Could not parse integer from input!");
-    }
-    ptr = e_ptr;
-
-    // store, value guaranteed to be in [1, 99999]
-    *(arr_ptr++) = value;
 
+  // store, values guaranteed to be in [1, 99999]
+  array.clear();
+  value_type value = 0;
+  while (array.size() < num_vals && tokens.next(value)) {
+    array.push_back(value);
   }
-  parse_stdin_end:
+  const size_t num_read = array.size();
+  array.push_back(0);
 
   // sort input degree sequence in place in descending order
-  std::sort(arr_start, arr_end, std::greater<value_type>());
+  std::sort(array.begin(), array.end(), std::greater<value_type>());
 
-  return num_vals;
+  return num_read;
 }
 
 inline constexpr value_type mod_mul(
@@ -123,62 +74,301 @@ inline constexpr value_type mod_inv(value_type value, value_type modulo) {
   return mod_exp(value, modulo - 2, modulo);
 }
 
-int main(int argc, char** argv) {
-  try {
-    constexpr size_t N_MAX = 100000;
-    constexpr value_type MODULO = 1000 * 1000 * 1000 + 7;
-    constexpr value_type inv12 = mod_inv(12, MODULO);
+constexpr value_type D_MAX = 100000;
+constexpr value_type MODULO = 1000 * 1000 * 1000 + 7;
 
-    value_type array[N_MAX] = {};
+/** Division free reduction mod MODULO, equal to % MODULO.
+ */
+using Mod = Barrett<MODULO>;
 
-    auto n = prepare_input(&array[0], &array[N_MAX - 1]);
+/** Number of nodes of each degree, read in one streaming pass.
+ *  Degrees are guaranteed to be in [1, D_MAX).
+ *
+ *  The counts are kept between cases and grow to the largest degree
+ *  seen; only the range touched by the previous case is cleared.
+ */
+class DegreeHistogram {
+    std::vector<value_type> count;
+    size_t num_nodes;
+    value_type max_degree;
+  public:
+    DegreeHistogram() : count(), num_nodes(0), max_degree(0) {}
+
+    /** Reads the number of nodes followed by the degree sequence.
+     *  Returns false if the input holds no further case.
+     */
+    bool read(Tokenizer& tokens) {
+      std::fill(count.begin(), count.begin() + max_degree, 0);
+      num_nodes = 0;
+      max_degree = 0;
+
+      value_type num_vals = 0;
+      if (!tokens.next(num_vals)) {
+        return false;
+      }
 
-    // at least 7 nodes are required for non zero result
-    if (n < 7) {
-      std::cout << 0 << "\n";
-      return 0;
+      value_type value = 0;
+      while (num_nodes < num_vals && tokens.next(value)) {
+        if (value >= D_MAX) {
+          throw std::runtime_error("Error: Degree out of range!");
+        }
+        if (value >= count.size()) {
+          count.resize(value + 1, 0);
+        }
+        if (value >= max_degree) {
+          max_degree = value + 1;
+        }
+        count[value]++;
+        num_nodes++;
+      }
+      return true;
     }
 
-    const value_type denom = mod_inv(n - 2, MODULO);
-    uint64_t sum = 0;
+    size_t size() const { return num_nodes; }
 
-    // Timer<double> timer;
-    for (value_type *i = &array[0]; *i > 3; i++) {
+    /** One past the largest degree of the case.
+     */
+    value_type limit() const { return max_degree; }
 
-      const uint64_t DI = *i;
-      const uint64_t di = *i - 1;
-      const uint64_t didim1 = di * (di - 1);
+    value_type operator[](value_type degree) const { return count[degree]; }
+};
 
-      uint64_t agg = 0;
-      uint64_t ival = ((4 * didim1 * didim1) % MODULO) * (didim1 - di);
+/** Sum over pairs of nodes i, j with degrees D_i >= D_j, D_i > 3, D_j > 2
+ *  of d_i (d_i - 1) d_j (d_j - 1) (d_i + d_j) (d_i + d_j - 4), d = D - 1,
+ *  as computed by pair_sum(const value_type *).
+ *
+ *  Walks the distinct degrees in ascending order. Expanding the last two
+ *  factors, the sum over smaller degrees j is
+ *    d_i (d_i - 4) S_0 + (2 d_i - 4) S_1 + S_2,
+ *    S_k = \sum_j d_j (d_j - 1) d_j ^ k,
+ *  with the S_k kept as running prefix sums.
+ */
+value_type pair_sum(const DegreeHistogram& hist) {
+  uint64_t sum = 0;
+  uint64_t s0 = 0, s1 = 0, s2 = 0;
+
+  for (value_type D = 3; D < hist.limit(); D++) {
+    const uint64_t c = hist[D];
+    if (!c) {
+      continue;
+    }
 
-      auto j = i + 1;
+    const uint64_t di = D - 1;
+    const uint64_t didim1 = di * (di - 1);
 
-      while (*j == DI) {
-        j++;
+    if (D > 3) {
+      // pairs with equal degree, same terms as the sorted loop
+      uint64_t ival = Mod::reduce(4 * didim1 * didim1) * (didim1 - di);
+      for (uint64_t k = 1; k < c; k++) {
+        sum = Mod::reduce(sum + Mod::mul(ival, k));
       }
 
-      sum = (sum + mod_mul(ival, j - i - 1, MODULO)) % MODULO;
+      // pairs with a smaller degree, for each of the c nodes
+      const uint64_t a = Mod::reduce(Mod::mul(di, di) + MODULO - 4 * di);
+      uint64_t agg = Mod::reduce(Mod::mul(a, s0) 
+                                 + Mod::mul(2 * di - 4, s1) + s2);
+      agg = Mod::mul(agg, Mod::reduce(didim1));
+      sum = Mod::reduce(sum + Mod::mul(agg, c));
+    }
+
+    const uint64_t w = Mod::mul(Mod::reduce(didim1), c);
+    s0 = Mod::reduce(s0 + w);
+    s1 = Mod::reduce(s1 + Mod::mul(w, di));
+    s2 = Mod::reduce(s2 + Mod::mul(Mod::mul(w, di), di));
+  }
+
+  return sum;
+}
+
+/** Pair sum contribution of the nodes [first, last) of the degree
+ *  sequence sorted in descending order, terminated by a degree below 3.
+ *  Each node i pairs with the nodes after it.
+ */
+value_type pair_sum(const value_type * first, const value_type * last) {
+  uint64_t sum = 0;
+
+  for (const value_type *i = first; i != last; i++) {
+
+    const uint64_t DI = *i;
+    const uint64_t di = *i - 1;
+    const uint64_t didim1 = di * (di - 1);
+
+    uint64_t agg = 0;
+    uint64_t ival = Mod::reduce(4 * didim1 * didim1) * (didim1 - di);
+
+    auto j = i + 1;
 
-      for (; *j > 2; j++) {
-        const uint64_t dj = *j - 1;
-        const uint64_t djdjm1 = dj * (dj - 1);
-        const auto d = di + dj;
-        uint64_t jval = ((d - 4) * d) % MODULO;
-        jval *= djdjm1;
-        agg = (agg + jval) % MODULO;
+    while (*j == DI) {
+      j++;
+    }
+
+    sum = Mod::reduce(sum + Mod::mul(ival, j - i - 1));
+
+    for (; *j > 2; j++) {
+      const uint64_t dj = *j - 1;
+      const uint64_t djdjm1 = dj * (dj - 1);
+      const auto d = di + dj;
+      uint64_t jval = Mod::reduce((d - 4) * d);
+      jval *= djdjm1;
+      agg = Mod::reduce(agg + jval);
+    }
+
+    sum = Mod::reduce(sum + agg * didim1);
+
+  }
+
+  return sum;
+}
+
+/** Pair sum over the degree sequence sorted in descending order,
+ *  terminated by a degree below 3.
+ *
+ *  With num_threads > 1 the nodes of degree above 3 are split into 
+ *  contiguous chunks of roughly equal work: the inner loop of node i
+ *  runs up to the last node of degree above 2, so it shrinks as i moves
+ *  down the sequence. The partial sums are combined in chunk order.
+ */
+value_type pair_sum(const value_type * array, unsigned num_threads) {
+  auto i_end = array;
+  while (*i_end > 3) {
+    i_end++;
+  }
+  auto j_end = i_end;
+  while (*j_end > 2) {
+    j_end++;
+  }
+
+  if (num_threads < 2 || i_end == array) {
+    return pair_sum(array, i_end);
+  }
+
+  // cost of node i is the length of its inner loop, plus one
+  uint64_t total = 0;
+  for (auto i = array; i != i_end; i++) {
+    total += j_end - i;
+  }
+
+  // chunk k ends once the cumulative cost reaches (k + 1) / num_threads
+  std::vector<const value_type *> bounds(1, array);
+  uint64_t cost = 0;
+  for (auto i = array; i != i_end; i++) {
+    cost += j_end - i;
+    if (cost * num_threads >= total * bounds.size() && i + 1 != i_end) {
+      bounds.push_back(i + 1);
+    }
+  }
+  bounds.push_back(i_end);
+
+  const auto num_chunks = bounds.size() - 1;
+  std::vector<value_type> partial(num_chunks, 0);
+  std::vector<std::thread> threads;
+  for (size_t k = 1; k < num_chunks; k++) {
+    threads.emplace_back([&, k]() {
+      partial[k] = pair_sum(bounds[k], bounds[k + 1]);
+    });
+  }
+  partial[0] = pair_sum(bounds[0], bounds[1]);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  uint64_t sum = 0;
+  for (auto value : partial) {
+    sum = Mod::reduce(sum + value);
+  }
+  return sum;
+}
+
+/** Expected number of stickmen for n nodes with the given pair sum.
+ */
+value_type expectation(size_t n, value_type sum) {
+  constexpr value_type inv12 = mod_inv(12, MODULO);
+
+  // at least 7 nodes are required for non zero result
+  if (n < 7) {
+    return 0;
+  }
+
+  const value_type denom = mod_inv(n - 2, MODULO);
+  return mod_mul(mod_mul(sum, inv12, MODULO), denom, MODULO);
+}
+
+/** Usage: a.out [--sorted] [--threads N] [--batch] [--bench N] < input
+ *  --sorted runs the original sort based pair loop instead of the
+ *  degree histogram, --threads splits that loop over N threads.
+ *  --batch reads cases, each the number of nodes followed by the 
+ *  degrees, until the end of input and prints one answer per case.
+ *  --bench times N runs of the pair sum on the parsed input and
+ *  prints the summary to stderr.
+ */
+int main(int argc, char** argv) {
+  OutputSink out;
+  try {
+    bool sorted = false;
+    bool batch = false;
+    unsigned num_threads = 1;
+    size_t bench_trials = 0;
+    for (int k = 1; k < argc; k++) {
+      if (!strcmp(argv[k], "--sorted")) {
+        sorted = true;
+      } else if (!strcmp(argv[k], "--threads") && k + 1 < argc) {
+        num_threads = strtoul(argv[++k], nullptr, 10);
+        sorted = true;
+      } else if (!strcmp(argv[k], "--batch")) {
+        batch = true;
+      } else if (!strcmp(argv[k], "--bench") && k + 1 < argc) {
+        bench_trials = strtoul(argv[++k], nullptr, 10);
+      } else {
+        throw std::runtime_error("Error: Unknown argument!");
       }
+    }
 
-      sum = (sum + agg * didim1) % MODULO;
+    if (batch && sorted) {
+      throw std::runtime_error("Error: --batch uses the degree histogram!");
+    }
 
+    if (batch) {
+      Tokenizer tokens(std::cin);
+      DegreeHistogram hist;
+      while (hist.read(tokens)) {
+        out.put(expectation(hist.size(), pair_sum(hist)));
+      }
+      return 0;
     }
 
-    std::cout << mod_mul(mod_mul(sum, inv12, MODULO), denom, MODULO) << "\n";
-    // std::cout << timer.toc() << "\n";
+    size_t n = 0;
+    value_type sum = 0;
+
+    if (sorted) {
+      std::vector<value_type> array;
+      n = prepare_input(array);
+      sum = pair_sum(array.data(), num_threads);
+      if (bench_trials) {
+        Benchmark bench("stickman_trees/sorted", 3, bench_trials);
+        auto run = [&]() {
+          do_not_optimize(pair_sum(array.data(), num_threads));
+        };
+        bench.run(run).print(std::cerr);
+      }
+    } else {
+      Tokenizer tokens(std::cin);
+      DegreeHistogram hist;
+      if (!hist.read(tokens)) {
+        throw std::runtime_error("Error: Could not parse integer from input!");
+      }
+      n = hist.size();
+      sum = pair_sum(hist);
+      if (bench_trials) {
+        Benchmark bench("stickman_trees/histogram", 3, bench_trials);
+        bench.run([&]() { do_not_optimize(pair_sum(hist)); }).print(std::cerr);
+      }
+    }
 
+    out.put(expectation(n, sum));
 
   } catch(std::exception& exception) {
-    std::cout << exception.what() << "\n";
+    out.put(exception.what(), strlen(exception.what()));
+    out.put("\n", 1);
   }
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,32 @@
+import sys
+import random
+import argparse
+
+def degrees(rng, n):
+  '''
+    Degree sequence of a uniformly random labelled tree on n >= 2 nodes:
+    node k has degree 1 plus its number of occurrences in a random
+    Pruefer sequence of length n - 2.
+  '''
+  degree = [1] * n
+  for _ in range(n - 2):
+    degree[rng.randrange(n)] += 1
+  return degree
+
+def main():
+  parser = argparse.ArgumentParser(description='Writes a seeded tree input.')
+  parser.add_argument('--nodes', type=int, default=10 ** 6)
+  parser.add_argument('--cases', type=int, default=1,
+                      help='more than one case needs a.out --batch')
+  parser.add_argument('--seed', type=int, default=0)
+  args = parser.parse_args()
+
+  rng = random.Random(args.seed)
+  out = sys.stdout
+  for _ in range(args.cases):
+    out.write('{}\n'.format(args.nodes))
+    out.write(' '.join(map(str, degrees(rng, args.nodes))))
+    out.write('\n')
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,32 @@
+import sys
+import random
+import argparse
+
+def rows(rng, num_rows):
+  '''
+    Yields CSV rows in the format of test.csv:
+    STRING,<int in [0, 1e7)>,<double in [0, 1e7) with 6 decimals>
+  '''
+  for _ in range(num_rows):
+    yield 'STRING,{},{:.6f}\n'.format(rng.randrange(10 ** 7),
+                                       rng.random() * 10 ** 7)
+
+def main():
+  parser = argparse.ArgumentParser(description='Writes a seeded CSV input.')
+  parser.add_argument('--rows', type=int, default=80 * 10 ** 6,
+                      help='number of rows, the default is about 2.5 GB')
+  parser.add_argument('--seed', type=int, default=0)
+  args = parser.parse_args()
+
+  rng = random.Random(args.seed)
+  out = sys.stdout
+  batch = []
+  for row in rows(rng, args.rows):
+    batch.append(row)
+    if len(batch) == 1 << 16:
+      out.write(''.join(batch))
+      batch = []
+  out.write(''.join(batch))
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,62 @@
+import os
+import json
+import tempfile
+import subprocess
+
+# rows of the edge cases file, the last one without a newline
+EDGE_ROWS = [
+  'KEY,0,1.5',
+  'KEY,999999,2.5',
+  'KEY,1000000,5.0',
+  'KEY,-12,5.25',
+  'KEY,12,0.5',
+  'KEY,1234567,3.5',
+  'OTHER,120,55.5',
+  'KEY,7,5',
+]
+
+# filter flag of a.out: row predicate on the split fields
+FILTERS = {
+  '': lambda fields: True,
+  '--range': lambda fields: 0 <= int(fields[1]) <= 999999,
+  '--prefix': lambda fields: fields[1].startswith('12'),
+  '--last': lambda fields: fields[2].startswith('5'),
+}
+
+def expected_rows(file_path, accept):
+  '''
+    Number of rows of a CSV file of the form STRING,int,double
+    accepted by a filter
+  '''
+  with open(file_path) as f:
+    rows = [line.split(',') for line in f.read().split('\n') if line]
+  return sum(1 for fields in rows if accept(fields))
+
+def cpp_rows(file_path, flag):
+  '''
+    Number of rows parsed by a.out with a filter flag, from its
+    JSON result
+  '''
+  cmd = ['./a.out', file_path, '1'] + ([flag] if flag else [])
+  result = json.loads(subprocess.check_output(cmd))
+  return result['rows']
+
+def check(file_path):
+  '''
+    Compares the full and the filtered row counts with the reference
+  '''
+  for flag, accept in FILTERS.items():
+    expected = expected_rows(file_path, accept)
+    actual = cpp_rows(file_path, flag)
+    assert actual == expected, \
+      'Cpp test Failed, {} {}: {} != {}'.format(file_path, flag or 'all',
+                                               actual, expected)
+
+if __name__ == '__main__':
+  check('test.csv')
+  with tempfile.NamedTemporaryFile('w', suffix='.csv', delete=False) as f:
+    f.write('\n'.join(EDGE_ROWS))
+  try:
+    check(f.name)
+  finally:
+    os.remove(f.name)
@@ -5,20 +5,8 @@
 #include <utility> 
 #include <cstdint>
 #include <fstream>
-#include <chrono>
-template<typename Type> 
-class Timer {
-    using Clock = std::chrono::high_resolution_clock;
-    using TimePoint = Clock::time_point;
-    TimePoint tick_point;
-  public:
-    Timer() { tick_point = Clock::now(); }
-    void tic() { tick_point = Clock::now(); }
-    Type toc() { 
-      using namespace std::chrono;
-      return duration_cast<duration<Type>>(Clock::now() - tick_point).count(); 
-    }
-};
+
+#include "bench.hpp"
 /*
     To do:
       - StringView parse
@@ -87,13 +75,87 @@ inline StringView str2type<StringView>(const char * s_ptr, char ** e_ptr) {
   return StringView(s_ptr, const_cast<const char *&>(*e_ptr));
 }
 
-template<char sep, char ldel, char term, typename... Args>
-class TupleParser {
+/** Row filters, checked on the raw bytes [s_ptr, e_ptr) of column
+ *  Filter::column before it is converted. A rejected row is skipped
+ *  up to its ldel, without converting the fields after that column.
+ */
+struct NoFilter {
+  static constexpr std::size_t column = std::size_t(-1);
+  static constexpr bool accept(const char *, const char *) { return true; }
+};
+
+// fields starting with the characters prefix...
+template<std::size_t col, char... prefix>
+struct PrefixFilter {
+  static constexpr std::size_t column = col;
+  static bool accept(const char * s_ptr, const char * e_ptr) {
+    constexpr char chars[] = {prefix..., '\0'};
+    if(e_ptr - s_ptr < std::ptrdiff_t(sizeof...(prefix))) {
+      return false;
+    }
+    for(std::size_t i = 0; i < sizeof...(prefix); ++i) {
+      if(s_ptr[i] != chars[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// integer fields in [lo, hi], anything else is rejected
+template<std::size_t col, int64_t lo, int64_t hi>
+struct RangeFilter {
+  static constexpr std::size_t column = col;
+  static bool accept(const char * s_ptr, const char * e_ptr) {
+    const bool neg = s_ptr < e_ptr && *s_ptr == '-';
+    s_ptr += neg;
+    if(s_ptr == e_ptr || e_ptr - s_ptr > 18) {
+      return false;
+    }
+    int64_t value = 0;
+    for(; s_ptr < e_ptr; ++s_ptr) {
+      const unsigned digit = unsigned(*s_ptr - '0');
+      if(digit > 9) {
+        return false;
+      }
+      value = value * 10 + digit;
+    }
+    value = neg ? -value : value;
+    return lo <= value && value <= hi;
+  }
+};
+
+template<char sep, char ldel, char term, typename Filter, typename... Args>
+class FilteredTupleParser {
+    static_assert(Filter::column < sizeof...(Args)
+               || Filter::column == NoFilter::column, "Filter column!");
     std::tuple<Args...> internal;
+    static const char * field_end(const char * ptr) {
+      while((*ptr) != sep && (*ptr) != ldel && (*ptr) != term) {
+        ++ptr;
+      }
+      return ptr;
+    }
+    static void skip_row(const char *& ptr) {
+      while((*ptr) != ldel && (*ptr) != term) {
+        ++ptr;
+      }
+    }
+    template<std::size_t i>
+    static bool accept(const char *& ptr) {
+      if(i == Filter::column && !Filter::accept(ptr, field_end(ptr))) {
+        skip_row(ptr);
+        return false;
+      }
+      return true;
+    }
     template<std::size_t i = std::size_t(0)> constexpr 
     typename std::enable_if<(i == sizeof...(Args) - 1), bool>::type 
     parse(const char *& ptr) {
       using type = typename std::tuple_element<i, std::tuple<Args...>>::type;
+      if(!accept<i>(ptr)) {
+        return false;
+      }
       char * e_ptr = nullptr;
       std::get<i>(internal) = str2type<type>(ptr, &e_ptr);
       if(e_ptr == ptr) {
@@ -106,6 +168,9 @@ class TupleParser {
     typename std::enable_if<(i < sizeof...(Args) - 1), bool>::type 
     parse(const char *& ptr) {
       using type = typename std::tuple_element<i, std::tuple<Args...>>::type;
+      if(!accept<i>(ptr)) {
+        return false;
+      }
       char * e_ptr = nullptr;
       std::get<i>(internal) = str2type<type>(ptr, &e_ptr);
       if(e_ptr == ptr) {
@@ -122,6 +187,7 @@ class TupleParser {
       return parse<i + 1>(ptr);
     }
   public:
+    // false if the row is malformed or rejected by the filter
     bool parse(const char *& ptr) { return parse<>(ptr); }
     template<std::size_t i> constexpr
     typename std::tuple_element<i, std::tuple<Args...>>::type get() const {
@@ -138,7 +204,21 @@ class TupleParser {
       return true;
     }
 };
+template<char sep, char ldel, char term, typename... Args>
+using TupleParser = FilteredTupleParser<sep, ldel, term, NoFilter, Args...>;
 using LineParser = TupleParser<',', '\n', '\0', StringView, int64_t, double>;
+// rows with the integer column below 10^6, about 10% of py/generate.py rows
+using RangeParser = FilteredTupleParser<',', '\n', '\0',
+                                        RangeFilter<1, 0, 999999>,
+                                        StringView, int64_t, double>;
+// rows with the integer column starting with 12
+using PrefixParser = FilteredTupleParser<',', '\n', '\0',
+                                         PrefixFilter<1, '1', '2'>,
+                                         StringView, int64_t, double>;
+// rows with the last column starting with 5
+using LastParser = FilteredTupleParser<',', '\n', '\0',
+                                       PrefixFilter<2, '5'>,
+                                       StringView, int64_t, double>;
 
 class FileBuffer {
     const std::size_t   bf_size;
@@ -149,12 +229,15 @@ class FileBuffer {
       , ptr(new char[bf_size])
     {}
    ~FileBuffer() { delete [] ptr; }
+   // reads at most bf_size - 1 bytes and terminates them with '\0'
    void load_file(const char * f_name) {
      std::ifstream is(f_name, std::ios::binary);
      is.seekg(0, std::ios::end);
      std::size_t len = is.tellg();
      is.seekg(0, std::ios::beg);
-     is.read(ptr, len > bf_size ? bf_size:len);
+     len = len < bf_size ? len : bf_size - 1;
+     is.read(ptr, len);
+     ptr[len] = '\0';
      is.close();
    }
     void load_file(std::string & f_name) {
@@ -163,27 +246,69 @@ class FileBuffer {
     const char * get_ptr() const { return ptr; } 
 };
 
-void test(FileBuffer &fb, LineParser& lp) {
+// returns the number of rows parsed
+template<typename Parser>
+std::size_t test(FileBuffer &fb, Parser& lp, const char * f_name) {
   using namespace std;
-  fb.load_file("test.csv");
+  fb.load_file(f_name);
   const char *ptr = fb.get_ptr();
+  std::size_t rows = 0;
   while(true) {
     if(lp.parse(ptr)) {
+      ++rows;
     }
     if(!lp.nextl(ptr)) {
       break;
     }
   }
+  return rows;
+}
+
+// times trials runs of test() with a Parser and prints the result,
+// along with the number of rows parsed
+template<typename Parser>
+void run(FileBuffer &fb, const char * f_name, const std::string & name,
+         int64_t n_tests) {
+  Parser parser;
+  std::size_t rows = 0;
+  Benchmark bench(name, n_tests < 10 ? 0 : 10, n_tests);
+  auto result = bench.run([&]() {
+    rows = test(fb, parser, f_name);
+    do_not_optimize(rows);
+  });
+  result.extra.emplace_back("rows", rows);
+  result.print(std::cout);
 }
 
-int main() {
+/** Usage: a.out [FILE [TRIALS [--range | --prefix | --last]]]
+ *  Times TRIALS reads and parses of FILE, test.csv 1000 times by default.
+ *  With a flag, the rows are filtered by RangeParser, PrefixParser or
+ *  LastParser instead. The buffer is sized to hold the whole file.
+ */
+int main(int argc, char** argv) {
   using namespace std;
-  int64_t n_tests = 1000LL;
-  FileBuffer fb(1048576ULL);
-  LineParser lp;
-  Timer<double> timer;
-  for(int64_t i = 0LL; i < n_tests; i++) {
-    test(fb, lp);
+  const char * f_name = argc > 1 ? argv[1] : "test.csv";
+  int64_t n_tests = argc > 2 ? atoll(argv[2]) : 1000LL;
+  const string filter = argc > 3 ? argv[3] : "";
+  ifstream is(f_name, ios::binary | ios::ate);
+  if(!is) {
+    cerr << "Could not open " << f_name << "\n";
+    return 1;
   }
-  cout << n_tests << " file reads and parses in: " << timer.toc() << "s\n";
-}
\ No newline at end of file
+  const std::size_t len = is.tellg();
+  is.close();
+  FileBuffer fb(len + 1 > 1048576ULL ? len + 1 : 1048576ULL);
+  const string name = string("str2tuple/") + f_name;
+  if(filter.empty()) {
+    run<LineParser>(fb, f_name, name, n_tests);
+  } else if(filter == "--range") {
+    run<RangeParser>(fb, f_name, name + "/range", n_tests);
+  } else if(filter == "--prefix") {
+    run<PrefixParser>(fb, f_name, name + "/prefix", n_tests);
+  } else if(filter == "--last") {
+    run<LastParser>(fb, f_name, name + "/last", n_tests);
+  } else {
+    cerr << "Unknown filter " << filter << "\n";
+    return 1;
+  }
+}